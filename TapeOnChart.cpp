@@ -2,6 +2,9 @@
 #include <vector>
 #include <unordered_map>
 #include <cstring>
+#include <climits>
+#include "bbo_timeline.h"
+#include "depth_ring.h"
 using std::string;
 SCDLLName("Frozen Tundra - Tape On Chart")
 std::string REVISION = "2024-02-08a";
@@ -50,6 +53,20 @@ struct SymbolData
     // list of bar indicies with count of repeating records for each bar index
     std::unordered_map<int, int> RepeatRecordsByIndex;
 
+    // best bid/offer from the T&S bid/ask updates, used to find the size advertised right before a print
+    BboTimeline Quotes;
+
+    // recent top of book snapshots, for the size that was showing at a large print's price
+    DepthRing Depth;
+
+    // SEQUENCE => SIZE SHOWING AT THE PRICE RIGHT BEFORE THE LARGE PRINT
+    std::unordered_map<int, float> DisplayedSizes;
+
+    // snapshots are stamped with the system clock as they come in. a print's time plus the
+    // smallest (system - tape) gap seen so far is the earliest it could have reached us,
+    // so depth updates that already had it in are after that. also takes up the time zone
+    long long TapeToSystemMs = LLONG_MAX;
+
 };
 
 // primary struct to hold various info
@@ -67,6 +84,20 @@ struct TOC
     // struct to hold tape, records of large or repeating prints, icebergs
     std::unordered_map<std::string, SymbolData> SymData;
 
+    // quote in effect before each new execution, same index as the T&S array
+    // and tagged with the execution's sequence since the array shifts between calls
+    std::vector<std::pair<int, BboQuote>> PrevailingQuotes;
+
+    // scratch space for reading depth into the ring
+    std::vector<float> DepthBidPrice;
+    std::vector<float> DepthBidQty;
+    std::vector<float> DepthAskPrice;
+    std::vector<float> DepthAskQty;
+
+    // chart's last bar when the T&S was last read, a new execution always moves one of them
+    int TaSArraySize = -1;
+    float TaSLastVolume = -1;
+
     // constructor - set SC obj
     TOC(SCStudyInterfaceRef &SCIntRef) : sc(SCIntRef)
     {
@@ -209,6 +240,7 @@ sc.AddMessageToLog(msg,0);
 
                 if (FoundRecord->second.LargeRecords.size() > NUM_PRINTS_TO_DISPLAY && FoundRecord->second.LargeRecords.size() > 0)
                 {
+                    FoundRecord->second.DisplayedSizes.erase(FoundRecord->second.LargeRecords.front().Sequence);
                     FoundRecord->second.LargeRecords.erase(FoundRecord->second.LargeRecords.begin());
                 }
             }
@@ -278,6 +310,32 @@ sc.AddMessageToLog(msg,0);
         }
     }
 
+    // remember the size that was showing at a large print's price right before it
+    void SetDisplayedSize(const std::string &Symbol, int Sequence, float Size)
+    {
+        auto FoundRecord = SymData.find(Symbol.c_str());
+        if (FoundRecord != SymData.end())
+        {
+            FoundRecord->second.DisplayedSizes[Sequence] = Size;
+        }
+    }
+
+    // size that was showing at a large print's price right before it, false if it wasn't captured
+    bool GetDisplayedSize(const std::string &Symbol, int Sequence, float &Size)
+    {
+        auto FoundRecord = SymData.find(Symbol.c_str());
+        if (FoundRecord != SymData.end())
+        {
+            auto Found = FoundRecord->second.DisplayedSizes.find(Sequence);
+            if (Found != FoundRecord->second.DisplayedSizes.end())
+            {
+                Size = Found->second;
+                return true;
+            }
+        }
+        return false;
+    }
+
     // get largest quantity seen executed in a single trade for a given symbol
     int GetLargestSizeSeen(const std::string &Symbol)
     {
@@ -383,6 +441,9 @@ sc.AddMessageToLog(msg,0);
             FoundRecord.second.Tape.clear();
             FoundRecord.second.LargeRecords.clear();
             FoundRecord.second.LatestSequence = 0;
+            FoundRecord.second.Quotes.Clear();
+            FoundRecord.second.Depth.Clear();
+            FoundRecord.second.DisplayedSizes.clear();
 
             // if no symbol passed, delete everything
             if (Symbol.c_str() == "")
@@ -423,6 +484,12 @@ sc.AddMessageToLog(msg,0);
 
 };
 
+// milliseconds since the SC epoch, the depth ring's clock
+long long GetDepthRingTimeMs(const SCDateTime &DateTime)
+{
+    return (long long)DateTime.GetDate() * 86400000 + DateTime.GetTimeInMilliseconds();
+}
+
 SCSFExport scsf_TapeOnChart(SCStudyInterfaceRef sc)
 {
     // Subgraphs
@@ -463,6 +530,7 @@ SCSFExport scsf_TapeOnChart(SCStudyInterfaceRef sc)
     SCInputRef i_HugeAskColor            = sc.Input[++InputIdx];
     SCInputRef i_HugeAskBgColor          = sc.Input[++InputIdx];
     SCInputRef i_PinnedBgColor           = sc.Input[++InputIdx];
+    SCInputRef i_NumDepthLevels          = sc.Input[++InputIdx];
 
     if (sc.SetDefaults)
     {
@@ -567,12 +635,19 @@ SCSFExport scsf_TapeOnChart(SCStudyInterfaceRef sc)
         i_PinnedBgColor.Name = "Pinned Prints Background Color";
         i_PinnedBgColor.SetColor(COLOR_BLACK);
 
+        i_NumDepthLevels.Name = "Depth Levels For Large Prints (0=off)";
+        i_NumDepthLevels.SetInt(0);
+        i_NumDepthLevels.SetIntLimits(0, 100);
+
         return;
     }
 
     // set GDI hook
     sc.p_GDIFunction = DrawToChart;
 
+    // only called on depth updates when large prints get the size that was showing
+    sc.UsesMarketDepthData = i_NumDepthLevels.GetInt() > 0;
+
     SCString msg;
 
     // bar period for current chart
@@ -600,10 +675,50 @@ SCSFExport scsf_TapeOnChart(SCStudyInterfaceRef sc)
     int HIGH_VOLUME_THRESHOLD       = i_LargeExecutionThreshold.GetInt();
     int HUGE_VOLUME_THRESHOLD       = i_HugeExecutionThreshold.GetInt();
 
+    // snapshot the top of book first, this study also gets called on depth updates
+    DepthRing &Depth = p_toc->SymData[sc.Symbol.GetChars()].Depth;
+    int NUM_DEPTH_LEVELS = i_NumDepthLevels.GetInt();
+    long long NowMs = GetDepthRingTimeMs(sc.CurrentSystemDateTime);
+    Depth.Configure(NUM_DEPTH_LEVELS, sc.TickSize);
+    if (Depth.IsEnabled() && sc.Index == sc.ArraySize-1)
+    {
+        p_toc->DepthBidPrice.resize(NUM_DEPTH_LEVELS);
+        p_toc->DepthBidQty.resize(NUM_DEPTH_LEVELS);
+        p_toc->DepthAskPrice.resize(NUM_DEPTH_LEVELS);
+        p_toc->DepthAskQty.resize(NUM_DEPTH_LEVELS);
+        s_MarketDepthEntry BidEntry;
+        s_MarketDepthEntry AskEntry;
+        for (int i=0; i<NUM_DEPTH_LEVELS; i++)
+        {
+            // levels past the end of the book come back zeroed
+            sc.GetBidMarketDepthEntryAtLevel(BidEntry, i);
+            sc.GetAskMarketDepthEntryAtLevel(AskEntry, i);
+            p_toc->DepthBidPrice[i] = BidEntry.Price;
+            p_toc->DepthBidQty[i] = (float)BidEntry.Quantity;
+            p_toc->DepthAskPrice[i] = AskEntry.Price;
+            p_toc->DepthAskQty[i] = (float)AskEntry.Quantity;
+        }
+        Depth.Add(NowMs, p_toc->DepthBidPrice.data(), p_toc->DepthBidQty.data(),
+            p_toc->DepthAskPrice.data(), p_toc->DepthAskQty.data(), NUM_DEPTH_LEVELS);
+    }
+
     // grab raw time and sales
     c_SCTimeAndSalesArray TaS;
     if (sc.Index == sc.ArraySize-1)
     {
+        // depth only update, nothing new on the tape and no reset or cleanup to do
+        float LastVolume = sc.Volume[sc.ArraySize-1];
+        if (sc.ArraySize == p_toc->TaSArraySize && LastVolume == p_toc->TaSLastVolume
+            && !sc.LastCallToFunction
+            && sc.CharacterEventCode == 0
+            && sc.Symbol == p_toc->PrevSymbol
+            && bp.IntradayChartBarPeriodParameter1 == p_toc->PrevBarPeriod)
+        {
+            return;
+        }
+        p_toc->TaSArraySize = sc.ArraySize;
+        p_toc->TaSLastVolume = LastVolume;
+
         // only get T&S on live bar
         sc.GetTimeAndSales(TaS);
     }
@@ -683,6 +798,19 @@ sc.AddMessageToLog(msg,0);
         LargestAdvertisedSize = 0;
     }
 
+    // join new executions to the quote in effect right before them
+    // NOTE: the loop below walks newest first, the quote timeline has to be built oldest first
+    BboTimeline &Quotes = p_toc->SymData[sc.Symbol.GetChars()].Quotes;
+    if (p_toc->GetLatestSequenceForSymbol(sc.Symbol.GetChars()) == 0)
+    {
+        // reprocessing the whole tape, rebuild the quotes with it
+        Quotes.Clear();
+    }
+    p_toc->PrevailingQuotes.resize(NumRecords);
+    Quotes.Ingest(TaS, [p_toc, &TaS](int Index, const BboQuote &Quote) {
+        p_toc->PrevailingQuotes[Index] = std::make_pair(TaS[Index].Sequence, Quote);
+    });
+
     SCString Output;
     int Counter = 0;
     // print most recent executions from time and sales
@@ -708,6 +836,19 @@ sc.AddMessageToLog(msg,0);
         // skip Level 2 updates and other types, we only want actual executions
         if (Type != SC_TS_BID && Type != SC_TS_ASK) continue;
 
+        // size advertised right before this print, when the feed sends bid/ask updates.
+        // records already ingested on an earlier call are looked up instead
+        const BboQuote *p_Quote = &p_toc->PrevailingQuotes[i].second;
+        if (p_toc->PrevailingQuotes[i].first != Sequence)
+        {
+            p_Quote = Quotes.FindBySequence(Sequence);
+        }
+        if (p_Quote != NULL && p_Quote->IsValid())
+        {
+            BidSize = p_Quote->BidSize;
+            AskSize = p_Quote->AskSize;
+        }
+
         // store this execution, we'll want to draw it
         p_toc->AddTimeAndSalesRecord(sc.Symbol.GetChars(), TaS[i]);
 
@@ -718,6 +859,18 @@ sc.AddMessageToLog(msg,0);
         {
             // high volume execution detected, store it
             p_toc->AddLargeRecord(sc.Symbol.GetChars(), TaS[i]);
+
+            // how much was showing at that price right before it, to compare against what executed.
+            // the print's time goes onto the system clock the snapshots were stamped with
+            long long &TapeToSystemMs = p_toc->SymData[sc.Symbol.GetChars()].TapeToSystemMs;
+            long long PrintMs = GetDepthRingTimeMs(TaS[i].DateTime);
+            TapeToSystemMs = std::min(TapeToSystemMs, NowMs - PrintMs);
+            int Snapshot = Depth.FindBefore(PrintMs + TapeToSystemMs);
+            if (Snapshot >= 0)
+            {
+                int Side = Type == SC_TS_BID ? DEPTH_RING_BID : DEPTH_RING_ASK;
+                p_toc->SetDisplayedSize(sc.Symbol.GetChars(), Sequence, Depth.GetSize(Snapshot, Side, Price));
+            }
         }
 
 
@@ -858,6 +1011,7 @@ void DrawToChart(HWND WindowHandle, HDC DeviceContext, SCStudyInterfaceRef sc)
     SCInputRef i_HugeAskColor            = sc.Input[++InputIdx];
     SCInputRef i_HugeAskBgColor          = sc.Input[++InputIdx];
     SCInputRef i_PinnedBgColor           = sc.Input[++InputIdx];
+    SCInputRef i_NumDepthLevels          = sc.Input[++InputIdx];
 
     SCString msg;
 
@@ -1112,7 +1266,18 @@ void DrawToChart(HWND WindowHandle, HDC DeviceContext, SCStudyInterfaceRef sc)
                     int DisplayVolume = Volume;
                     if (sc.SecurityType() == n_ACSIL::SECURITY_TYPE_STOCK) DisplayVolume = Volume/100;
 
-                    Output.Format("%d     %.2f", DisplayVolume, Price);
+                    // executed/displayed when we know what was showing at the price before it
+                    float DisplayedSize;
+                    if (p_toc->GetDisplayedSize(sc.Symbol.GetChars(), Record.Sequence, DisplayedSize))
+                    {
+                        int DisplayDisplayed = (int)DisplayedSize;
+                        if (sc.SecurityType() == n_ACSIL::SECURITY_TYPE_STOCK) DisplayDisplayed = DisplayDisplayed/100;
+                        Output.Format("%d/%d     %.2f", DisplayVolume, DisplayDisplayed, Price);
+                    }
+                    else
+                    {
+                        Output.Format("%d     %.2f", DisplayVolume, Price);
+                    }
                     ::TextOut(DeviceContext, x, y, Output, Output.GetLength());
 
                     Counter++;
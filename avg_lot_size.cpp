@@ -1,4 +1,8 @@
 #include "sierrachart.h"
+#include <vector>
+#include "depth_delta.h"
+#include "depth_kernel.h"
+#include "number_format.h"
 
 SCDLLName("Frozen Tundra - Guitarmadillo")
 
@@ -10,6 +14,70 @@ SCDLLName("Frozen Tundra - Guitarmadillo")
 */
 void DrawToChart(HWND WindowHandle, HDC DeviceContext, SCStudyInterfaceRef sc); 
 
+// one side of the book, structure of arrays indexed by depth level
+struct DepthSide {
+    std::vector<float> Price;
+    std::vector<float> Quantity;
+    std::vector<unsigned int> NumOrders;
+    std::vector<float> AvgLot;
+    std::vector<float> CumQuantity;
+
+    void Resize(int num_levels) {
+        Price.assign(num_levels, 0);
+        Quantity.assign(num_levels, 0);
+        NumOrders.assign(num_levels, 0);
+        AvgLot.assign(num_levels, 0);
+        CumQuantity.assign(num_levels, 0);
+    }
+
+    // avg lots and cumulative size for every level in one pass
+    void Analyse() {
+        DepthKernelSide side;
+        side.Quantity = Quantity.data();
+        side.NumOrders = NumOrders.data();
+        side.AvgLot = AvgLot.data();
+        side.CumQuantity = CumQuantity.data();
+        DepthKernel(side, (int)Quantity.size());
+    }
+};
+
+// depth snapshot owned by the study and read by the GDI hook.
+// only resized when the number of levels changes, so depth updates don't allocate.
+struct DepthSnapshot {
+    DepthSide Bid;
+    DepthSide Ask;
+    int NumLevels = 0;
+
+    // bumped every time the snapshot is filled, 0 means nothing to draw yet
+    unsigned int Version = 0;
+
+    // bid vs ask size over the first ImbalanceLevels, -1 to 1
+    float Imbalance = 0;
+
+    // added/pulled/traded per price, fed from this snapshot and the T&S
+    DepthDeltaEngine Delta;
+    int LatestSequence = 0;
+
+    // T&S copy, reused so a fetch doesn't allocate, and the chart's last bar when it was
+    // fetched. a new execution always moves one of them so depth-only updates skip the fetch.
+    c_SCTimeAndSalesArray TimeSales;
+    int TimeSalesArraySize = -1;
+    float TimeSalesLastVolume = -1;
+
+    // label text, kept across repaints
+    NumberFormatter Labels;
+
+    void Resize(int num_levels) {
+        if (num_levels == NumLevels) {
+            return;
+        }
+        Bid.Resize(num_levels);
+        Ask.Resize(num_levels);
+        NumLevels = num_levels;
+        Version = 0;
+    }
+};
+
 SCSFExport scsf_AverageLotSize(SCStudyInterfaceRef sc)
 {
     // number of depth levels to calculate avg lots for
@@ -24,6 +92,15 @@ SCSFExport scsf_AverageLotSize(SCStudyInterfaceRef sc)
     // spacing padding to align numbers to DOM prices
     SCInputRef VerticalOffset = sc.Input[3];
 
+    // rolling window for added/pulled/traded through size
+    SCInputRef DeltaWindowSeconds = sc.Input[4];
+
+    // which delta total to print in the second general purpose DOM column
+    SCInputRef DeltaDisplay = sc.Input[5];
+
+    // levels to sum for the bid/ask imbalance, 0 to hide it
+    SCInputRef ImbalanceLevels = sc.Input[6];
+
     // logging object
     SCString log_message;
 
@@ -41,26 +118,40 @@ SCSFExport scsf_AverageLotSize(SCStudyInterfaceRef sc)
         FontSize.SetInt(22);
         VerticalOffset.Name = "Vertical Offset in Pixels";
         VerticalOffset.SetInt(10);
+        DeltaWindowSeconds.Name = "Delta Window in Seconds";
+        DeltaWindowSeconds.SetInt(60);
+        DeltaWindowSeconds.SetIntLimits(1, 3600);
+        DeltaDisplay.Name = "Delta Column Display";
+        DeltaDisplay.SetCustomInputStrings("Off;Net Added-Pulled;Added;Pulled;Traded Through");
+        DeltaDisplay.SetCustomInputIndex(0);
+        ImbalanceLevels.Name = "Imbalance Levels (0 = Off)";
+        ImbalanceLevels.SetInt(0);
+        ImbalanceLevels.SetIntLimits(0, 1000);
         return;
     }
 
+    // depth snapshot persists between calls and is shared with our windows GDI call
+    DepthSnapshot *p_Snapshot = (DepthSnapshot *)sc.GetPersistentPointer(0);
+    if (sc.LastCallToFunction) {
+        delete p_Snapshot;
+        sc.SetPersistentPointer(0, NULL);
+        return;
+    }
+    if (p_Snapshot == NULL) {
+        p_Snapshot = new DepthSnapshot;
+        sc.SetPersistentPointer(0, p_Snapshot);
+    }
+
     int num_levels = NumberOfLevels.GetInt();
+    p_Snapshot->Resize(num_levels);
 
     // SierraChart object for a market depth record
     s_MarketDepthEntry bid_mde;
-    s_MarketDepthEntry ask_mde;        // used for calculating avg lot sizes
-    float bid_avg_lot = 0;
-    float ask_avg_lot = 0;
-
-    // pointers to dynamically allocated arrays
-    float *p_bidAvgLots;
-    float *p_askAvgLots;
-
-    // malloc memory for arrays
-    p_bidAvgLots = (float *) sc.AllocateMemory( 1024 * sizeof(float) );
-    p_askAvgLots = (float *) sc.AllocateMemory( 1024 * sizeof(float) );
+    s_MarketDepthEntry ask_mde;
 
     // grab market depth data
+    DepthSide &bids = p_Snapshot->Bid;
+    DepthSide &asks = p_Snapshot->Ask;
     for (int i=0; i<num_levels; i++) {
         sc.GetBidMarketDepthEntryAtLevel(bid_mde, i);
         sc.GetAskMarketDepthEntryAtLevel(ask_mde, i);
@@ -69,44 +160,89 @@ SCSFExport scsf_AverageLotSize(SCStudyInterfaceRef sc)
         //log_message.Format("i=%d, BxA=%f x %f, Count BxA=%d x %d", i, (float)bid_mde.Quantity, (float)ask_mde.Quantity, bid_mde.NumOrders, ask_mde.NumOrders);
         //sc.AddMessageToLog(log_message, 1);
 
-        // the calculations for avg lot size
-        bid_avg_lot = (float)bid_mde.Quantity / bid_mde.NumOrders;
-        ask_avg_lot = (float)ask_mde.Quantity / ask_mde.NumOrders;
-
-        // store in arrays
-        p_bidAvgLots[i] = bid_avg_lot;
-        p_askAvgLots[i] = ask_avg_lot;
-
+        bids.Price[i] = bid_mde.Price;
+        bids.Quantity[i] = (float)bid_mde.Quantity;
+        bids.NumOrders[i] = bid_mde.NumOrders;
+        asks.Price[i] = ask_mde.Price;
+        asks.Quantity[i] = (float)ask_mde.Quantity;
+        asks.NumOrders[i] = ask_mde.NumOrders;
     }
 
-    // we need these data to persist to our windows GDI call
-    sc.SetPersistentInt(0, num_levels);
-    sc.SetPersistentPointer(0, p_bidAvgLots);
-    sc.SetPersistentPointer(1, p_askAvgLots);
-    //log_message.Format("?P?P? bidAvg=%d x askAvg=%d", *p_bidAvgLots, *p_askAvgLots);
-    //sc.AddMessageToLog(log_message, 1);
+    // the calculations for avg lot size, levels with no orders come out 0
+    bids.Analyse();
+    asks.Analyse();
+    int imbalance_levels = ImbalanceLevels.GetInt() < num_levels ? ImbalanceLevels.GetInt() : num_levels;
+    p_Snapshot->Imbalance = DepthImbalance(bids.CumQuantity.data(), asks.CumQuantity.data(), imbalance_levels);
+
+    // let the GDI call know there's a new snapshot
+    p_Snapshot->Version++;
+
+    // order book deltas, executions first so size that left the book can be split into traded vs pulled
+    if (DeltaDisplay.GetIndex() > 0) {
+        DepthDeltaEngine &delta = p_Snapshot->Delta;
+        delta.SetTickSize(sc.TickSize);
+        delta.SetWindowMs(DeltaWindowSeconds.GetInt() * 1000LL);
+
+        // NOTE: MAKE SURE TO UPDATE GLOBAL SETTINGS -> NUM TIME AND SALES RECORDS!
+        c_SCTimeAndSalesArray &time_sales = p_Snapshot->TimeSales;
+        int num_records = 0;
+        float last_volume = sc.ArraySize > 0 ? sc.Volume[sc.ArraySize-1] : 0;
+        if (sc.ArraySize != p_Snapshot->TimeSalesArraySize || last_volume != p_Snapshot->TimeSalesLastVolume) {
+            sc.GetTimeAndSales(time_sales);
+            num_records = time_sales.Size();
+            p_Snapshot->TimeSalesArraySize = sc.ArraySize;
+            p_Snapshot->TimeSalesLastVolume = last_volume;
+        }
+        if (num_records > 0) {
+            // tape went backwards (reconnect, replay restart), start over
+            if (time_sales[num_records-1].Sequence < p_Snapshot->LatestSequence) {
+                p_Snapshot->LatestSequence = 0;
+                delta.Reset();
+            }
+
+            // only records we haven't seen, and only executions
+            int first_new = num_records;
+            while (first_new > 0 && (p_Snapshot->LatestSequence == 0 || time_sales[first_new-1].Sequence > p_Snapshot->LatestSequence)) {
+                first_new--;
+            }
+            for (int i=first_new; i<num_records; i++) {
+                if (time_sales[i].Type == SC_TS_BID) {
+                    delta.AddTrade(time_sales[i].Price, (float)time_sales[i].Volume, DEPTH_DELTA_BID);
+                }
+                else if (time_sales[i].Type == SC_TS_ASK) {
+                    delta.AddTrade(time_sales[i].Price, (float)time_sales[i].Volume, DEPTH_DELTA_ASK);
+                }
+            }
+            p_Snapshot->LatestSequence = time_sales[num_records-1].Sequence;
+        }
+
+        long long now_ms = (long long)(sc.CurrentSystemDateTime.GetAsDouble() * 86400000.0);
+        delta.Update(now_ms, bids.Price.data(), bids.Quantity.data(), num_levels,
+                asks.Price.data(), asks.Quantity.data(), num_levels);
+    }
 
     // draw
     sc.p_GDIFunction = DrawToChart;
-
-    // free up memory
-    sc.FreeMemory(p_bidAvgLots);
-    sc.FreeMemory(p_askAvgLots);
 }
 
 void DrawToChart(HWND WindowHandle, HDC DeviceContext, SCStudyInterfaceRef sc)
 {
-    int num_levels = sc.GetPersistentInt(0);
+    // fetch the snapshot built by the study function
+    DepthSnapshot *p_Snapshot = (DepthSnapshot *)sc.GetPersistentPointer(0);
+    if (p_Snapshot == NULL || p_Snapshot->Version == 0) {
+        return;
+    }
+    const DepthSide &bids = p_Snapshot->Bid;
+    const DepthSide &asks = p_Snapshot->Ask;
+    int num_levels = p_Snapshot->NumLevels;
+
     int bidX = sc.GetDOMColumnLeftCoordinate(n_ACSIL::DOM_COLUMN_GENERAL_PURPOSE_1);
     int bidY;
     int askX = bidX;
     int askY;
     SCString msg;
 
-    // fetch the arrays of data
-    float *p_bidAvgLots = (float *)sc.GetPersistentPointer(0);
-    float *p_askAvgLots = (float *)sc.GetPersistentPointer(1);    float lastPrice = sc.Close[sc.Index];
-    float plotPrice = 0;
+    float lastPrice = sc.Close[sc.Index];
     //msg.Format("tickSize=%f, lastPrice=%f", tickSize, lastPrice);
     //sc.AddMessageToLog(msg, 1);
 
@@ -124,52 +260,81 @@ void DrawToChart(HWND WindowHandle, HDC DeviceContext, SCStudyInterfaceRef sc)
     // Windows GDI transparency 
     // https://docs.microsoft.com/en-us/windows/win32/api/wingdi/nf-wingdi-setbkmode
     SetBkMode(DeviceContext, TRANSPARENT);
-    int NumberOfDecimals = sc.Input[1].GetInt();
     int padding = sc.Input[3].GetInt();
+
+    // avg lot is shares/contracts per order so it isn't scaled, deltas are volume and stocks show in round lots
+    NumberFormatter &labels = p_Snapshot->Labels;
+    NumberFormat lot_format(sc.Input[1].GetInt());
+    NumberFormat delta_format(0, sc.SecurityType() == n_ACSIL::SECURITY_TYPE_STOCK ? NUMBER_DIVISOR_ROUND_LOTS : NUMBER_DIVISOR_NONE);
+    NumberFormat imbalance_format(0, NUMBER_DIVISOR_NONE, true, '%');
     for (int i=0; i<num_levels; i++) {
 
-        // calculate coords
-        plotPrice = sc.Bid - (i * sc.TickSize);
-        bidY = sc.RegionValueToYPixelCoordinate(plotPrice, sc.GraphRegion);
-        plotPrice = sc.Ask + (i * sc.TickSize);
-        askY = sc.RegionValueToYPixelCoordinate(plotPrice, sc.GraphRegion);
-
-        // formatting of number of decimal places
-        switch (NumberOfDecimals) {
-            case 0:
-                msg.Format("%.0f", *(p_bidAvgLots + i));
-                break;
-            case 1:
-                msg.Format("%.1f", *(p_bidAvgLots + i));
-                break;
-            case 2:
-                msg.Format("%.2f", *(p_bidAvgLots + i));
-                break;                    }
-
-        // print bid side text on DOM
-        ::SetTextAlign(DeviceContext, TA_NOUPDATECP);
-        ::TextOut(DeviceContext, bidX, bidY - padding, msg, msg.GetLength());
-
-        // munge ask side text together
-        //msg.Format("%f", *(p_askAvgLots + i));
-        switch (NumberOfDecimals) {
-            case 0:
-                msg.Format("%.0f", *(p_askAvgLots + i));
-                break;
-            case 1:
-                msg.Format("%.1f", *(p_askAvgLots + i));
-                break;
-            case 2:
-                msg.Format("%.2f", *(p_askAvgLots + i));
-                break;                    }
+        // print bid side text on DOM, a thin book leaves empty levels at price 0
+        if (bids.Price[i] > 0) {
+            bidY = sc.RegionValueToYPixelCoordinate(bids.Price[i], sc.GraphRegion);
+            const NumberLabel &bid_label = labels.Format(bids.AvgLot[i], lot_format);
+            ::SetTextAlign(DeviceContext, TA_NOUPDATECP);
+            ::TextOut(DeviceContext, bidX, bidY - padding, bid_label.Text, bid_label.Length);
+        }
 
         // print ask side text to DOM
+        if (asks.Price[i] > 0) {
+            askY = sc.RegionValueToYPixelCoordinate(asks.Price[i], sc.GraphRegion);
+            const NumberLabel &ask_label = labels.Format(asks.AvgLot[i], lot_format);
+            ::SetTextAlign(DeviceContext, TA_NOUPDATECP);
+            ::TextOut(DeviceContext, askX, askY - padding, ask_label.Text, ask_label.Length);
+        }
+    }
+
+    // imbalance one row above the deepest ask
+    if (sc.Input[6].GetInt() > 0 && num_levels > 0 && asks.Price[num_levels-1] > 0) {
+        const NumberLabel &imbalance_label = labels.Format(p_Snapshot->Imbalance * 100, imbalance_format);
+        askY = sc.RegionValueToYPixelCoordinate(asks.Price[num_levels-1] + sc.TickSize, sc.GraphRegion);
         ::SetTextAlign(DeviceContext, TA_NOUPDATECP);
-        ::TextOut(DeviceContext, askX, askY - padding, msg, msg.GetLength());
+        ::TextOut(DeviceContext, askX, askY - padding, imbalance_label.Text, imbalance_label.Length);
+    }
 
-        // delete font
-        DeleteObject(hFont);
+    // order book deltas in the column next to the avg lots
+    int delta_display = sc.Input[5].GetIndex();
+    if (delta_display > 0) {
+        const DepthDeltaEngine &delta = p_Snapshot->Delta;
+        long long now_ms = (long long)(sc.CurrentSystemDateTime.GetAsDouble() * 86400000.0);
+        int deltaX = sc.GetDOMColumnLeftCoordinate(n_ACSIL::DOM_COLUMN_GENERAL_PURPOSE_2);
+        for (int i=0; i<num_levels; i++) {
+            for (int side=0; side<2; side++) {
+                float price = side == DEPTH_DELTA_BID ? bids.Price[i] : asks.Price[i];
+                if (price <= 0) {
+                    continue;
+                }
+                DepthDeltaTotals totals = delta.Get(now_ms, price, side);
+                float value = 0;
+                switch (delta_display) {
+                    case 1:
+                        value = totals.Net();
+                        break;
+                    case 2:
+                        value = totals.Added;
+                        break;
+                    case 3:
+                        value = totals.Pulled;
+                        break;
+                    case 4:
+                        value = totals.Traded;
+                        break;
+                }
+                if (value == 0) {
+                    continue;
+                }
+                const NumberLabel &delta_label = labels.Format(value, delta_format);
+                int y = sc.RegionValueToYPixelCoordinate(price, sc.GraphRegion);
+                ::SetTextAlign(DeviceContext, TA_NOUPDATECP);
+                ::TextOut(DeviceContext, deltaX, y - padding, delta_label.Text, delta_label.Length);
+            }
+        }
     }
 
+    // delete font
+    DeleteObject(hFont);
+
     return;
 }
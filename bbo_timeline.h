@@ -0,0 +1,152 @@
+#pragma once
+#include "sierrachart.h"
+#include <vector>
+
+/*
+    Written by Frozen Tundra
+
+    Best bid/offer timeline built from the bid/ask update records in time and sales
+    (SC_TS_BIDASKVALUES), the ones the execution loops skip as "Level 2 updates".
+
+    Ingest() walks new T&S records oldest first and hands every execution the quote
+    that was in effect right before it, so joining a print to its quote is O(1).
+    Older quotes stay in a fixed size ring for lookups by sequence or time.
+*/
+
+struct BboQuote
+{
+    int Sequence = 0;
+    SCDateTime DateTime;
+    float Bid = 0;
+    float Ask = 0;
+    unsigned int BidSize = 0;
+    unsigned int AskSize = 0;
+
+    bool IsValid() const { return Bid > 0 && Ask > 0; }
+};
+
+const int BBO_TIMELINE_DEFAULT_CAPACITY = 65536;
+
+class BboTimeline
+{
+    public:
+        BboTimeline(int Capacity = BBO_TIMELINE_DEFAULT_CAPACITY) : m_Quotes(Capacity > 0 ? Capacity : 1)
+        {
+        }
+
+        void Clear()
+        {
+            m_NumQuotes = 0;
+            m_Current = BboQuote();
+            LatestSequence = 0;
+        }
+
+        // last T&S record ingested
+        int LatestSequence = 0;
+
+        // quote in effect after the last record ingested
+        const BboQuote& Current() const { return m_Current; }
+
+        // number of quotes still in the ring, 0 is the oldest
+        int Size() const { return m_NumQuotes < (long long)m_Quotes.size() ? (int)m_NumQuotes : (int)m_Quotes.size(); }
+
+        const BboQuote& GetQuote(int Index) const
+        {
+            long long First = m_NumQuotes - Size();
+            return m_Quotes[(size_t)((First + Index) % m_Quotes.size())];
+        }
+
+        // ingest records we haven't seen yet, oldest first.
+        // OnExecution(Index, Quote) gets the T&S index of every new execution and the quote in effect before it.
+        template <typename F>
+        void Ingest(const c_SCTimeAndSalesArray& TimeSales, F OnExecution)
+        {
+            int NumRecords = TimeSales.Size();
+            if (NumRecords == 0)
+            {
+                return;
+            }
+
+            // tape went backwards (reconnect, replay restart), start over
+            if (TimeSales[NumRecords-1].Sequence < LatestSequence)
+            {
+                Clear();
+            }
+
+            int FirstNew = NumRecords;
+            while (FirstNew > 0 && (LatestSequence == 0 || TimeSales[FirstNew-1].Sequence > LatestSequence))
+            {
+                FirstNew--;
+            }
+
+            for (int i=FirstNew; i<NumRecords; i++)
+            {
+                const s_TimeAndSales& Record = TimeSales[i];
+                if (Record.Type == SC_TS_BIDASKVALUES)
+                {
+                    AddQuote(Record);
+                }
+                else if (Record.Type == SC_TS_BID || Record.Type == SC_TS_ASK)
+                {
+                    OnExecution(i, m_Current);
+                }
+            }
+            LatestSequence = TimeSales[NumRecords-1].Sequence;
+        }
+
+        void Ingest(const c_SCTimeAndSalesArray& TimeSales)
+        {
+            Ingest(TimeSales, [](int, const BboQuote&) {});
+        }
+
+        // quote in effect just before the record with this sequence, NULL if it's older than the ring
+        const BboQuote* FindBySequence(int Sequence) const
+        {
+            return Find([Sequence](const BboQuote& Quote) { return Quote.Sequence < Sequence; });
+        }
+
+        // quote in effect at this time, NULL if it's older than the ring
+        const BboQuote* FindByDateTime(const SCDateTime& DateTime) const
+        {
+            return Find([&DateTime](const BboQuote& Quote) { return Quote.DateTime <= DateTime; });
+        }
+
+    private:
+        std::vector<BboQuote> m_Quotes;
+        long long m_NumQuotes = 0;
+        BboQuote m_Current;
+
+        void AddQuote(const s_TimeAndSales& Record)
+        {
+            BboQuote& Quote = m_Quotes[(size_t)(m_NumQuotes % m_Quotes.size())];
+            Quote.Sequence = Record.Sequence;
+            Quote.DateTime = Record.DateTime;
+            Quote.Bid = Record.Bid;
+            Quote.Ask = Record.Ask;
+            Quote.BidSize = Record.BidSize;
+            Quote.AskSize = Record.AskSize;
+            m_Current = Quote;
+            m_NumQuotes++;
+        }
+
+        // last quote for which IsBefore holds, quotes are in sequence/time order
+        template <typename F>
+        const BboQuote* Find(F IsBefore) const
+        {
+            int Lo = 0;
+            int Hi = Size();
+            while (Lo < Hi)
+            {
+                int Mid = Lo + (Hi - Lo) / 2;
+                if (IsBefore(GetQuote(Mid)))
+                {
+                    Lo = Mid + 1;
+                }
+                else
+                {
+                    Hi = Mid;
+                }
+            }
+            return Lo > 0 ? &GetQuote(Lo - 1) : NULL;
+        }
+};
@@ -0,0 +1,185 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cmath>
+
+/*
+    Written by Frozen Tundra
+
+    Consolidated order book merged from several symbols' depth, like ES and MES, or one
+    stock fed from several venues as separate symbols.
+
+    Every symbol's levels are normalised to a common tick and a contract multiplier
+    (MES = 0.1 on an ES chart). Each symbol has its own change counter that only moves
+    when its normalised levels really changed, and Merge() only takes the symbols whose
+    counter moved back out of the book and puts their new levels in.
+    Doesn't need sierrachart.h.
+*/
+
+const int BOOK_BID = 0;
+const int BOOK_ASK = 1;
+
+struct BookLevel
+{
+    int Tick;
+    float Qty;
+
+    bool operator==(const BookLevel &Other) const { return Tick == Other.Tick && Qty == Other.Qty; }
+};
+
+// one price in the consolidated book
+struct ConsolidatedLevel
+{
+    double Qty = 0;
+
+    // symbols showing size at this price, the price goes away when this gets to 0
+    int NumSources = 0;
+};
+
+struct BookSource
+{
+    std::string Symbol;
+    float Multiplier = 1;
+
+    // bumped when this symbol's levels change
+    unsigned int Version = 0;
+
+    // version that's in the consolidated book
+    unsigned int MergedVersion = 0;
+
+    // latest levels, and the levels that are in the consolidated book
+    std::vector<BookLevel> Levels[2];
+    std::vector<BookLevel> Merged[2];
+};
+
+class ConsolidatedBook
+{
+    public:
+        // symbols and their multipliers, starts over if the list changed
+        void SetSources(const std::vector<std::string> &Symbols, const std::vector<float> &Multipliers, float TickSize)
+        {
+            bool Same = Symbols.size() == m_Sources.size() && TickSize == m_TickSize;
+            for (size_t i=0; Same && i<Symbols.size(); i++)
+            {
+                Same = m_Sources[i].Symbol == Symbols[i] && m_Sources[i].Multiplier == Multipliers[i];
+            }
+            if (Same)
+            {
+                return;
+            }
+            m_Sources.assign(Symbols.size(), BookSource());
+            for (size_t i=0; i<Symbols.size(); i++)
+            {
+                m_Sources[i].Symbol = Symbols[i];
+                m_Sources[i].Multiplier = Multipliers[i];
+            }
+            m_TickSize = TickSize;
+            m_Book[BOOK_BID].clear();
+            m_Book[BOOK_ASK].clear();
+            Version++;
+        }
+
+        int NumSources() const { return (int)m_Sources.size(); }
+
+        const BookSource& GetSource(int Source) const { return m_Sources[Source]; }
+
+        float GetTickSize() const { return m_TickSize; }
+
+        // one symbol's levels for one side, inside market first. prices that fall between
+        // common ticks go to the tick that's worse for that side. false if nothing changed.
+        bool SetLevels(int Source, int Side, const float *Price, const float *Qty, int NumLevels)
+        {
+            if (m_TickSize <= 0)
+            {
+                return(false);
+            }
+            BookSource &s = m_Sources[Source];
+            m_Next.clear();
+            for (int i=0; i<NumLevels; i++)
+            {
+                if (Price[i] <= 0 || Qty[i] <= 0)
+                {
+                    continue;
+                }
+
+                // small nudge so a price that is on the grid doesn't land a tick away from float error
+                double Ticks = Price[i] / m_TickSize;
+                int Tick = Side == BOOK_BID ? (int)floor(Ticks + 1e-6) : (int)ceil(Ticks - 1e-6);
+                float Normalised = Qty[i] * s.Multiplier;
+                if (!m_Next.empty() && m_Next.back().Tick == Tick)
+                {
+                    m_Next.back().Qty += Normalised;
+                }
+                else
+                {
+                    m_Next.push_back(BookLevel{Tick, Normalised});
+                }
+            }
+            if (m_Next == s.Levels[Side])
+            {
+                return(false);
+            }
+            s.Levels[Side].swap(m_Next);
+            s.Version++;
+            return(true);
+        }
+
+        // bumped whenever Merge() changes the book
+        unsigned int Version = 0;
+
+        // take the symbols whose levels changed out of the book and put their new levels in
+        bool Merge()
+        {
+            bool Changed = false;
+            for (size_t i=0; i<m_Sources.size(); i++)
+            {
+                BookSource &s = m_Sources[i];
+                if (s.Version == s.MergedVersion)
+                {
+                    continue;
+                }
+                for (int Side=0; Side<2; Side++)
+                {
+                    std::unordered_map<int, ConsolidatedLevel> &Book = m_Book[Side];
+                    for (const BookLevel &Level : s.Merged[Side])
+                    {
+                        auto Found = Book.find(Level.Tick);
+                        if (Found != Book.end() && --Found->second.NumSources <= 0)
+                        {
+                            Book.erase(Found);
+                        }
+                        else if (Found != Book.end())
+                        {
+                            Found->second.Qty -= Level.Qty;
+                        }
+                    }
+                    for (const BookLevel &Level : s.Levels[Side])
+                    {
+                        ConsolidatedLevel &c = Book[Level.Tick];
+                        c.Qty += Level.Qty;
+                        c.NumSources++;
+                    }
+                    s.Merged[Side] = s.Levels[Side];
+                }
+                s.MergedVersion = s.Version;
+                Changed = true;
+            }
+            if (Changed)
+            {
+                Version++;
+            }
+            return(Changed);
+        }
+
+        // TICK => CONSOLIDATED SIZE, in no particular order
+        const std::unordered_map<int, ConsolidatedLevel>& GetSide(int Side) const { return m_Book[Side]; }
+
+    private:
+        std::vector<BookSource> m_Sources;
+        float m_TickSize = 0;
+        std::unordered_map<int, ConsolidatedLevel> m_Book[2];
+
+        // scratch space for the next set of levels
+        std::vector<BookLevel> m_Next;
+};
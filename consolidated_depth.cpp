@@ -0,0 +1,301 @@
+#include "sierrachart.h"
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include "consolidated_book.h"
+#include "number_format.h"
+
+SCDLLName("Frozen Tundra - Consolidated Depth")
+
+/*
+    Written by Frozen Tundra
+
+    Merges market depth from the chart's symbol and a list of related symbols
+    (ES and MES, or one stock fed from several venues) into one consolidated book
+    and draws its sizes in a DOM column. Sizes are in the chart symbol's contracts.
+    Every symbol in the list needs market depth coming in, an open DOM is enough.
+*/
+void DrawToChart(HWND WindowHandle, HDC DeviceContext, SCStudyInterfaceRef sc);
+
+// a price in the consolidated book to draw
+struct ConsolidatedRow {
+    float Price;
+    float Qty;
+    int Side;
+};
+
+// book built by the study function, the GDI call only reads it
+struct ConsolidatedSnapshot {
+    ConsolidatedBook Book;
+
+    // what the sources were set up from
+    std::string SymbolList;
+    std::string ChartSymbol;
+    float TickSize = -1;
+
+    // scratch space for reading one symbol's depth
+    std::vector<float> Price;
+    std::vector<float> Quantity;
+
+    // prices over the size filter, rebuilt when the book changes
+    std::vector<ConsolidatedRow> Rows;
+    unsigned int RowsVersion = 0;
+    int RowsMinimum = -1;
+
+    // text for each row, rebuilt by the GDI call only when RowsVersion moves
+    std::vector<SCString> Labels;
+    unsigned int LabelsVersion = 0;
+    NumberFormatter Numbers;
+};
+
+// "MESZ24-CME=0.1, ESZ24-CME" => symbols and contract multipliers, no multiplier means 1
+void ParseSymbolList(const std::string &list, std::vector<std::string> &symbols, std::vector<float> &multipliers)
+{
+    size_t start = 0;
+    while (start < list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        std::string item = list.substr(start, end - start);
+        start = end + 1;
+
+        float multiplier = 1;
+        size_t equals = item.find('=');
+        if (equals != std::string::npos) {
+            multiplier = (float)atof(item.c_str() + equals + 1);
+            item.erase(equals);
+        }
+
+        // trim spaces
+        size_t first = item.find_first_not_of(" \t");
+        size_t last = item.find_last_not_of(" \t");
+        if (first == std::string::npos || multiplier <= 0) {
+            continue;
+        }
+        symbols.push_back(item.substr(first, last - first + 1));
+        multipliers.push_back(multiplier);
+    }
+}
+
+SCSFExport scsf_ConsolidatedDepth(SCStudyInterfaceRef sc)
+{
+    // number of depth levels to read from each symbol
+    SCInputRef NumberOfLevels = sc.Input[0];
+
+    // other symbols to merge in, SYMBOL=MULTIPLIER separated by commas
+    SCInputRef OtherSymbols = sc.Input[1];
+
+    // prices are merged on this grid, 0 uses the chart's tick size
+    SCInputRef CommonTickSize = sc.Input[2];
+
+    // minimum consolidated size to render, in the chart symbol's contracts/shares
+    SCInputRef MinimumSize = sc.Input[3];
+
+    // font size to render sizes
+    SCInputRef FontSize = sc.Input[4];
+
+    // spacing padding to align numbers to DOM prices
+    SCInputRef VerticalOffset = sc.Input[5];
+
+    // DOM column to draw in
+    SCInputRef Column = sc.Input[6];
+
+    SCInputRef BidColor = sc.Input[7];
+    SCInputRef AskColor = sc.Input[8];
+
+    // Configuration
+    if (sc.SetDefaults)
+    {
+        sc.GraphRegion = 0;
+        sc.GraphShortName = "ConsolidatedDepth";
+        sc.UsesMarketDepthData = 1;
+
+        // depth updates on the other symbols don't call the study, this picks them up
+        sc.UpdateAlways = 1;
+
+        NumberOfLevels.Name = "Number of Market Depth Levels Per Symbol";
+        NumberOfLevels.SetInt(20);
+        NumberOfLevels.SetIntLimits(1, 1000);
+        OtherSymbols.Name = "Other Symbols (SYMBOL=MULTIPLIER, comma separated)";
+        OtherSymbols.SetString("");
+        CommonTickSize.Name = "Common Tick Size (0 = chart tick size)";
+        CommonTickSize.SetFloat(0);
+        MinimumSize.Name = "Minimum Consolidated Size (0 = all)";
+        MinimumSize.SetInt(0);
+        FontSize.Name = "Font Size";
+        FontSize.SetInt(20);
+        VerticalOffset.Name = "Vertical Offset in Pixels";
+        VerticalOffset.SetInt(10);
+        Column.Name = "DOM Column";
+        Column.SetCustomInputStrings("General Purpose 1;General Purpose 2");
+        Column.SetCustomInputIndex(0);
+        BidColor.Name = "Bid Text Color";
+        BidColor.SetColor(RGB(0, 200, 255));
+        AskColor.Name = "Ask Text Color";
+        AskColor.SetColor(RGB(255, 80, 80));
+        return;
+    }
+
+    // set GDI hook
+    sc.p_GDIFunction = DrawToChart;
+
+    // consolidated book persists between calls and is shared with our windows GDI call
+    ConsolidatedSnapshot *p_Snapshot = (ConsolidatedSnapshot *)sc.GetPersistentPointer(0);
+    if (sc.LastCallToFunction) {
+        delete p_Snapshot;
+        sc.SetPersistentPointer(0, NULL);
+        return;
+    }
+    if (p_Snapshot == NULL) {
+        p_Snapshot = new ConsolidatedSnapshot;
+        sc.SetPersistentPointer(0, p_Snapshot);
+    }
+    ConsolidatedBook &book = p_Snapshot->Book;
+
+    // sources are the chart's symbol plus the list, only parsed again when an input changes
+    std::string symbol_list = OtherSymbols.GetString();
+    std::string chart_symbol = sc.Symbol.GetChars();
+    float tick_size = CommonTickSize.GetFloat() > 0 ? CommonTickSize.GetFloat() : sc.TickSize;
+    if (symbol_list != p_Snapshot->SymbolList || chart_symbol != p_Snapshot->ChartSymbol || tick_size != p_Snapshot->TickSize) {
+        std::vector<std::string> symbols(1, chart_symbol);
+        std::vector<float> multipliers(1, 1.0f);
+        ParseSymbolList(symbol_list, symbols, multipliers);
+
+        // the chart's symbol is always in at 1x
+        for (size_t i=symbols.size()-1; i>0; i--) {
+            if (symbols[i] == chart_symbol) {
+                symbols.erase(symbols.begin() + i);
+                multipliers.erase(multipliers.begin() + i);
+            }
+        }
+
+        // a symbol listed twice would be counted twice, keep the first with the last multiplier given
+        for (size_t i=1; i<symbols.size(); i++) {
+            for (size_t j=i+1; j<symbols.size(); ) {
+                if (symbols[j] == symbols[i]) {
+                    multipliers[i] = multipliers[j];
+                    symbols.erase(symbols.begin() + j);
+                    multipliers.erase(multipliers.begin() + j);
+                }
+                else {
+                    j++;
+                }
+            }
+        }
+        book.SetSources(symbols, multipliers, tick_size);
+        p_Snapshot->SymbolList = symbol_list;
+        p_Snapshot->ChartSymbol = chart_symbol;
+        p_Snapshot->TickSize = tick_size;
+    }
+
+    // read every symbol's depth, a symbol's change counter only moves when its levels changed
+    int num_levels = NumberOfLevels.GetInt();
+    p_Snapshot->Price.resize(num_levels);
+    p_Snapshot->Quantity.resize(num_levels);
+    s_MarketDepthEntry mde;
+    for (int s=0; s<book.NumSources(); s++) {
+        SCString symbol = book.GetSource(s).Symbol.c_str();
+        for (int side=0; side<2; side++) {
+            int available = side == BOOK_BID ? sc.GetBidMarketDepthNumberOfLevelsForSymbol(symbol) : sc.GetAskMarketDepthNumberOfLevelsForSymbol(symbol);
+            int n = available < num_levels ? available : num_levels;
+            for (int i=0; i<n; i++) {
+                if (side == BOOK_BID) {
+                    sc.GetBidMarketDepthEntryAtLevelForSymbol(symbol, mde, i);
+                }
+                else {
+                    sc.GetAskMarketDepthEntryAtLevelForSymbol(symbol, mde, i);
+                }
+                p_Snapshot->Price[i] = mde.Price;
+                p_Snapshot->Quantity[i] = (float)mde.Quantity;
+            }
+            book.SetLevels(s, side, p_Snapshot->Price.data(), p_Snapshot->Quantity.data(), n);
+        }
+    }
+
+    // merge only the symbols that changed, rows only when the book or the filter moved
+    bool changed = book.Merge();
+    if (p_Snapshot->RowsMinimum != MinimumSize.GetInt()) {
+        p_Snapshot->RowsMinimum = MinimumSize.GetInt();
+        changed = true;
+    }
+    if (!changed) {
+        return;
+    }
+    p_Snapshot->Rows.clear();
+    for (int side=0; side<2; side++) {
+        for (const auto &level : book.GetSide(side)) {
+            if (level.second.Qty < p_Snapshot->RowsMinimum || level.second.Qty <= 0) {
+                continue;
+            }
+            ConsolidatedRow row;
+            row.Price = (float)(level.first * (double)book.GetTickSize());
+            row.Qty = (float)level.second.Qty;
+            row.Side = side;
+            p_Snapshot->Rows.push_back(row);
+        }
+    }
+    p_Snapshot->RowsVersion++;
+}
+
+void DrawToChart(HWND WindowHandle, HDC DeviceContext, SCStudyInterfaceRef sc)
+{
+    // fetch the book built by the study function
+    ConsolidatedSnapshot *p_Snapshot = (ConsolidatedSnapshot *)sc.GetPersistentPointer(0);
+    if (p_Snapshot == NULL || p_Snapshot->RowsVersion == 0) {
+        return;
+    }
+    const std::vector<ConsolidatedRow> &rows = p_Snapshot->Rows;
+
+    // only re-format the text when the book changed since the last repaint
+    if (p_Snapshot->LabelsVersion != p_Snapshot->RowsVersion) {
+        // stock sizes in thousands of shares, everything else as is
+        NumberFormat size_format(0, sc.SecurityType() == n_ACSIL::SECURITY_TYPE_STOCK ? NUMBER_DIVISOR_THOUSANDS : NUMBER_DIVISOR_NONE);
+        p_Snapshot->Labels.resize(rows.size());
+        for (size_t i=0; i<rows.size(); i++) {
+            p_Snapshot->Labels[i] = p_Snapshot->Numbers.Format(rows[i].Qty, size_format).Text;
+        }
+        p_Snapshot->LabelsVersion = p_Snapshot->RowsVersion;
+    }
+
+    int column = sc.Input[6].GetIndex() == 0 ? n_ACSIL::DOM_COLUMN_GENERAL_PURPOSE_1 : n_ACSIL::DOM_COLUMN_GENERAL_PURPOSE_2;
+    int x = sc.GetDOMColumnLeftCoordinate(column);
+    int vertical_offset = sc.Input[5].GetInt();
+    COLORREF bid_color = sc.Input[7].GetColor();
+    COLORREF ask_color = sc.Input[8].GetColor();
+
+    // only prices on screen
+    float v_high;
+    float v_low;
+    sc.GetMainGraphVisibleHighAndLow(v_high, v_low);
+
+    // grab the name of the font used in this chartbook
+    int fontSize = sc.Input[4].GetInt();
+    SCString chartFont = sc.ChartTextFont();
+
+    // Windows GDI font creation
+    // https://docs.microsoft.com/en-us/windows/win32/api/wingdi/nf-wingdi-createfonta
+    HFONT hFont;
+    hFont = CreateFont(fontSize,0,0,0,FW_BOLD,FALSE,FALSE,FALSE,DEFAULT_CHARSET,OUT_OUTLINE_PRECIS,
+            CLIP_DEFAULT_PRECIS,CLEARTYPE_QUALITY, DEFAULT_PITCH,TEXT(chartFont));
+    SelectObject(DeviceContext, hFont);
+
+    // Windows GDI transparency
+    // https://docs.microsoft.com/en-us/windows/win32/api/wingdi/nf-wingdi-setbkmode
+    SetBkMode(DeviceContext, TRANSPARENT);
+    ::SetTextAlign(DeviceContext, TA_NOUPDATECP);
+    for (size_t i=0; i<rows.size(); i++) {
+        if (rows[i].Price > v_high || rows[i].Price < v_low) {
+            continue;
+        }
+        int y = sc.RegionValueToYPixelCoordinate(rows[i].Price, sc.GraphRegion);
+        const SCString &label = p_Snapshot->Labels[i];
+        ::SetTextColor(DeviceContext, rows[i].Side == BOOK_BID ? bid_color : ask_color);
+        ::TextOut(DeviceContext, x, y - vertical_offset, label, label.GetLength());
+    }
+
+    // delete font
+    DeleteObject(hFont);
+
+    return;
+}
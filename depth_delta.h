@@ -0,0 +1,264 @@
+#pragma once
+#include <vector>
+#include <cmath>
+
+/*
+    Written by Frozen Tundra
+
+    Order book delta engine. Diffs consecutive depth snapshots by price (in ticks),
+    not by level number, since levels shift every time the inside market moves.
+
+    For every price it keeps how much size was added, pulled, and traded through
+    over a rolling window. Doesn't need sierrachart.h, feed it prices, sizes and trades.
+*/
+
+const int DEPTH_DELTA_BID = 0;
+const int DEPTH_DELTA_ASK = 1;
+
+// rolling window is split into this many buckets, old buckets expire lazily
+const int DEPTH_DELTA_NUM_BUCKETS = 8;
+
+// prices tracked either side of the inside market before we recenter
+const int DEPTH_DELTA_MIN_RANGE_TICKS = 256;
+
+struct DepthDeltaTotals {
+    float Added = 0;
+    float Pulled = 0;
+    float Traded = 0;
+
+    float Net() const { return Added - Pulled; }
+};
+
+class DepthDeltaEngine {
+    public:
+        void SetTickSize(float TickSize) {
+            if (TickSize != m_TickSize) {
+                m_TickSize = TickSize;
+                Reset();
+            }
+        }
+
+        void SetWindowMs(long long WindowMs) {
+            if (WindowMs < DEPTH_DELTA_NUM_BUCKETS) {
+                WindowMs = DEPTH_DELTA_NUM_BUCKETS;
+            }
+            if (WindowMs != m_WindowMs) {
+                m_WindowMs = WindowMs;
+                Reset();
+            }
+        }
+
+        void Reset() {
+            m_Slots.clear();
+            m_BaseTick = 0;
+            m_HasBook = false;
+            for (int Side=0; Side<2; Side++) {
+                m_Prev[Side].clear();
+                m_PrevDeepest[Side] = 0;
+            }
+        }
+
+        int PriceToTicks(float Price) const {
+            return (int)lround(Price / m_TickSize);
+        }
+
+        // executions since the last Update(), Side is the side of the book that got hit
+        void AddTrade(float Price, float Volume, int Side) {
+            if (!m_HasBook || m_TickSize <= 0) {
+                return;
+            }
+            Slot *p_Slot = GetSlot(PriceToTicks(Price));
+            if (p_Slot != NULL) {
+                p_Slot->Side[Side].PendingTraded += Volume;
+            }
+        }
+
+        // diff the current book against the last one, index 0 is the inside market.
+        // only prices whose size changed, appeared or disappeared touch the buckets.
+        void Update(long long NowMs, const float *BidPrice, const float *BidQty, int NumBid,
+                const float *AskPrice, const float *AskQty, int NumAsk) {
+            if (m_TickSize <= 0 || NumBid <= 0 || NumAsk <= 0 || BidPrice[0] <= 0 || AskPrice[0] <= 0) {
+                return;
+            }
+            long long Epoch = NowMs / GetBucketMs();
+            m_Stamp++;
+
+            int InsideTick = (PriceToTicks(BidPrice[0]) + PriceToTicks(AskPrice[0])) / 2;
+            int Range = GetRangeTicks(NumBid > NumAsk ? NumBid : NumAsk);
+            if (m_Slots.empty()) {
+                Recenter(InsideTick, Range);
+            }
+
+            const float *Prices[2] = {BidPrice, AskPrice};
+            const float *Sizes[2] = {BidQty, AskQty};
+            int Counts[2] = {NumBid, NumAsk};
+            for (int Side=0; Side<2; Side++) {
+                // skip empty levels at the back of the book
+                int Num = Counts[Side];
+                while (Num > 0 && Prices[Side][Num-1] <= 0) {
+                    Num--;
+                }
+                if (Num == 0) {
+                    continue;
+                }
+                int Deepest = PriceToTicks(Prices[Side][Num-1]);
+                int FarEdge = PriceToTicks(Prices[Side][0]) - Deepest;
+                if (FarEdge < 0) FarEdge = -FarEdge;
+                if (!InRange(PriceToTicks(Prices[Side][0])) || !InRange(Deepest)) {
+                    Recenter(InsideTick, Range > FarEdge * 2 ? Range : FarEdge * 2);
+                }
+
+                std::vector<int> &Current = m_Scratch;
+                Current.clear();
+                for (int i=0; i<Num; i++) {
+                    int Tick = PriceToTicks(Prices[Side][i]);
+                    Slot *p_Slot = GetSlot(Tick);
+                    if (p_Slot == NULL) {
+                        continue;
+                    }
+                    SideState &State = p_Slot->Side[Side];
+                    State.Seen = m_Stamp;
+                    Current.push_back(Tick);
+
+                    // a price that just scrolled into view isn't new liquidity
+                    bool Visible = m_HasBook && IsInside(Side, Tick, m_PrevDeepest[Side]);
+                    if (Visible && Sizes[Side][i] != State.Qty) {
+                        Apply(State, Epoch, Sizes[Side][i] - State.Qty);
+                    }
+                    State.Qty = Sizes[Side][i];
+                    State.PendingTraded = 0;
+                }
+
+                // prices that left the book, ignore the ones that fell off the back of what we read
+                for (size_t i=0; i<m_Prev[Side].size(); i++) {
+                    int Tick = m_Prev[Side][i];
+                    Slot *p_Slot = GetSlot(Tick);
+                    if (p_Slot == NULL || p_Slot->Side[Side].Seen == m_Stamp) {
+                        continue;
+                    }
+                    SideState &State = p_Slot->Side[Side];
+                    if (IsInside(Side, Tick, Deepest) && State.Qty > 0) {
+                        Apply(State, Epoch, -State.Qty);
+                    }
+                    State.Qty = 0;
+                    State.PendingTraded = 0;
+                }
+
+                m_Prev[Side].swap(Current);
+                m_PrevDeepest[Side] = Deepest;
+            }
+            m_HasBook = true;
+        }
+
+        // totals for a price over the rolling window ending at NowMs
+        DepthDeltaTotals Get(long long NowMs, float Price, int Side) const {
+            DepthDeltaTotals Totals;
+            if (m_TickSize <= 0) {
+                return(Totals);
+            }
+            const Slot *p_Slot = GetSlot(PriceToTicks(Price));
+            if (p_Slot == NULL) {
+                return(Totals);
+            }
+            long long Oldest = NowMs / GetBucketMs() - DEPTH_DELTA_NUM_BUCKETS;
+            const SideState &State = p_Slot->Side[Side];
+            for (int b=0; b<DEPTH_DELTA_NUM_BUCKETS; b++) {
+                if (State.Buckets[b].Epoch > Oldest) {
+                    Totals.Added += State.Buckets[b].Added;
+                    Totals.Pulled += State.Buckets[b].Pulled;
+                    Totals.Traded += State.Buckets[b].Traded;
+                }
+            }
+            return(Totals);
+        }
+
+    private:
+        struct Bucket {
+            long long Epoch = -1;
+            float Added = 0;
+            float Pulled = 0;
+            float Traded = 0;
+        };
+
+        struct SideState {
+            float Qty = 0;
+            float PendingTraded = 0;
+            unsigned int Seen = 0;
+            Bucket Buckets[DEPTH_DELTA_NUM_BUCKETS];
+        };
+
+        struct Slot {
+            SideState Side[2];
+        };
+
+        float m_TickSize = 0;
+        long long m_WindowMs = 60000;
+
+        // dense array of prices, m_Slots[0] is m_BaseTick
+        std::vector<Slot> m_Slots;
+        int m_BaseTick = 0;
+
+        // prices on each side of the last book, and how deep it went
+        std::vector<int> m_Prev[2];
+        int m_PrevDeepest[2] = {0, 0};
+        std::vector<int> m_Scratch;
+        unsigned int m_Stamp = 0;
+        bool m_HasBook = false;
+
+        long long GetBucketMs() const {
+            return m_WindowMs / DEPTH_DELTA_NUM_BUCKETS;
+        }
+
+        static int GetRangeTicks(int NumLevels) {
+            int Range = NumLevels * 8;
+            return Range > DEPTH_DELTA_MIN_RANGE_TICKS ? Range : DEPTH_DELTA_MIN_RANGE_TICKS;
+        }
+
+        bool InRange(int Tick) const {
+            return Tick >= m_BaseTick && Tick < m_BaseTick + (int)m_Slots.size();
+        }
+
+        Slot* GetSlot(int Tick) {
+            return InRange(Tick) ? &m_Slots[Tick - m_BaseTick] : NULL;
+        }
+
+        const Slot* GetSlot(int Tick) const {
+            return InRange(Tick) ? &m_Slots[Tick - m_BaseTick] : NULL;
+        }
+
+        // bids at or above the deepest bid, asks at or below the deepest ask
+        static bool IsInside(int Side, int Tick, int Deepest) {
+            return Side == DEPTH_DELTA_BID ? Tick >= Deepest : Tick <= Deepest;
+        }
+
+        // move the window so the inside market is in the middle, keeping what overlaps
+        void Recenter(int InsideTick, int Range) {
+            int NewBase = InsideTick - Range;
+            std::vector<Slot> NewSlots(Range * 2);
+            for (size_t i=0; i<m_Slots.size(); i++) {
+                int Index = m_BaseTick + (int)i - NewBase;
+                if (Index >= 0 && Index < (int)NewSlots.size()) {
+                    NewSlots[Index] = m_Slots[i];
+                }
+            }
+            m_Slots.swap(NewSlots);
+            m_BaseTick = NewBase;
+        }
+
+        // size went up is added, size went down was traded if there were prints there, otherwise pulled
+        void Apply(SideState &State, long long Epoch, float Change) {
+            Bucket &b = State.Buckets[Epoch % DEPTH_DELTA_NUM_BUCKETS];
+            if (b.Epoch != Epoch) {
+                b = Bucket();
+                b.Epoch = Epoch;
+            }
+            if (Change > 0) {
+                b.Added += Change;
+                return;
+            }
+            float Removed = -Change;
+            float Traded = State.PendingTraded < Removed ? State.PendingTraded : Removed;
+            b.Traded += Traded;
+            b.Pulled += Removed - Traded;
+        }
+};
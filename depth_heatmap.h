@@ -0,0 +1,265 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+/*
+    Written by Frozen Tundra
+
+    Time x price history of resting size for a depth heatmap.
+
+    Sizes are quantised to a byte on a log scale. Each snapshot only stores the
+    prices whose byte changed since the previous one. Snapshots are packed into
+    fixed size chunks that each start with a full snapshot, so any chunk can be
+    decoded on its own and the oldest chunks are dropped to stay inside the
+    memory budget. Doesn't need sierrachart.h.
+*/
+
+const size_t HEATMAP_CHUNK_BYTES = 64 * 1024;
+
+// log scale for quantising sizes, 255 is ~8.8 million
+const float HEATMAP_QUANT_SCALE = 16.0f;
+
+struct HeatmapLevel {
+    int Tick;
+    float Qty;
+};
+
+class DepthHeatmapHistory {
+    public:
+        static uint8_t Quantise(float Qty) {
+            if (Qty <= 0) {
+                return(0);
+            }
+            float q = log1pf(Qty) * HEATMAP_QUANT_SCALE;
+            return q >= 255 ? 255 : (q < 1 ? 1 : (uint8_t)q);
+        }
+
+        static float Dequantise(uint8_t q) {
+            return expm1f(q / HEATMAP_QUANT_SCALE);
+        }
+
+        void SetBudgetBytes(size_t BudgetBytes) {
+            m_MaxChunks = BudgetBytes / HEATMAP_CHUNK_BYTES;
+            if (m_MaxChunks < 2) {
+                m_MaxChunks = 2;
+            }
+            DropOldChunks();
+        }
+
+        void Clear() {
+            m_Chunks.clear();
+            m_Prev.clear();
+            m_MaxQ = 0;
+            Version++;
+        }
+
+        // bumped whenever a snapshot is stored
+        unsigned int Version = 0;
+
+        uint8_t GetMaxQ() const { return m_MaxQ; }
+
+        size_t GetBytes() const { return m_Chunks.size() * HEATMAP_CHUNK_BYTES; }
+
+        bool Empty() const { return m_Chunks.empty(); }
+
+        long long GetLastTimeMs() const { return m_Chunks.empty() ? 0 : m_Chunks.back().LastTimeMs; }
+
+        // store the book at TimeMs, both sides in any order. false if nothing changed.
+        bool Add(long long TimeMs, const HeatmapLevel *Levels, int NumLevels) {
+            // quantise, sort by price and combine a price showing on both sides of a crossed book
+            m_Next.clear();
+            for (int i=0; i<NumLevels; i++) {
+                uint8_t q = Quantise(Levels[i].Qty);
+                if (q > 0) {
+                    m_Next.push_back(Entry{Levels[i].Tick, q});
+                }
+            }
+            std::sort(m_Next.begin(), m_Next.end(), [](const Entry &a, const Entry &b) { return a.Tick < b.Tick; });
+            size_t Out = 0;
+            for (size_t i=0; i<m_Next.size(); i++) {
+                if (Out > 0 && m_Next[Out-1].Tick == m_Next[i].Tick) {
+                    m_Next[Out-1].q = std::max(m_Next[Out-1].q, m_Next[i].q);
+                }
+                else {
+                    m_Next[Out++] = m_Next[i];
+                }
+            }
+            m_Next.resize(Out);
+
+            // worst case every price changes, new chunk with a full snapshot if it won't fit
+            size_t WorstBytes = 20 + (m_Prev.size() + m_Next.size()) * 6;
+            bool NewChunk = m_Chunks.empty() || m_Chunks.back().Bytes.size() + WorstBytes > HEATMAP_CHUNK_BYTES
+                || TimeMs < m_Chunks.back().LastTimeMs;
+            if (NewChunk) {
+                m_Prev.clear();
+            }
+
+            Diff(m_Prev, m_Next, m_Changes);
+            if (!NewChunk && m_Changes.empty()) {
+                return(false);
+            }
+
+            if (NewChunk) {
+                m_Chunks.push_back(Chunk());
+                m_Chunks.back().Bytes.reserve(HEATMAP_CHUNK_BYTES);
+                m_Chunks.back().FirstTimeMs = TimeMs;
+                m_Chunks.back().LastTimeMs = TimeMs;
+                m_Chunks.back().RefTick = m_Next.empty() ? 0 : m_Next.front().Tick;
+                DropOldChunks();
+            }
+            Chunk &c = m_Chunks.back();
+
+            // time delta, number of changes, then (price delta, size) pairs
+            PutVarint(c.Bytes, (uint64_t)(TimeMs - c.LastTimeMs));
+            PutVarint(c.Bytes, m_Changes.size());
+            int PrevTick = c.RefTick;
+            for (size_t i=0; i<m_Changes.size(); i++) {
+                PutVarint(c.Bytes, ZigZag(m_Changes[i].Tick - PrevTick));
+                c.Bytes.push_back(m_Changes[i].q);
+                PrevTick = m_Changes[i].Tick;
+                if (m_Changes[i].q > m_MaxQ) {
+                    m_MaxQ = m_Changes[i].q;
+                }
+            }
+            if (!m_Next.empty()) {
+                c.MinTick = std::min(c.MinTick, m_Next.front().Tick);
+                c.MaxTick = std::max(c.MaxTick, m_Next.back().Tick);
+            }
+            c.LastTimeMs = TimeMs;
+            m_Prev.swap(m_Next);
+            Version++;
+            return(true);
+        }
+
+        // decode every snapshot that's in effect between FromMs and ToMs, oldest first.
+        // chunks with nothing between MinTick and MaxTick aren't decoded, OnSnapshot gets
+        // an empty book for them instead.
+        // OnSnapshot(TimeMs, Sizes, BaseTick, NumTicks), Sizes[i] is the quantised size at BaseTick+i
+        template <typename F>
+        void Replay(long long FromMs, long long ToMs, int MinTick, int MaxTick, F OnSnapshot) const {
+            std::vector<uint8_t> Dense;
+            for (size_t n=0; n<m_Chunks.size(); n++) {
+                const Chunk &c = m_Chunks[n];
+                if (c.FirstTimeMs > ToMs) {
+                    break;
+                }
+
+                // a later chunk already starts before the range, this one is entirely in the past
+                if (n + 1 < m_Chunks.size() && m_Chunks[n+1].FirstTimeMs <= FromMs) {
+                    continue;
+                }
+
+                if (c.MaxTick < MinTick || c.MinTick > MaxTick) {
+                    OnSnapshot(c.FirstTimeMs, (const uint8_t *)NULL, MinTick, 0);
+                    continue;
+                }
+
+                int BaseTick = c.MinTick;
+                Dense.assign(c.MaxTick - c.MinTick + 1, 0);
+                size_t Pos = 0;
+                long long TimeMs = c.FirstTimeMs;
+                while (Pos < c.Bytes.size()) {
+                    TimeMs += (long long)GetVarint(c.Bytes, Pos);
+                    uint64_t NumChanges = GetVarint(c.Bytes, Pos);
+                    int Tick = c.RefTick;
+                    for (uint64_t i=0; i<NumChanges; i++) {
+                        Tick += UnZigZag(GetVarint(c.Bytes, Pos));
+                        Dense[Tick - BaseTick] = c.Bytes[Pos++];
+                    }
+                    if (TimeMs > ToMs) {
+                        break;
+                    }
+                    OnSnapshot(TimeMs, Dense.data(), BaseTick, (int)Dense.size());
+                }
+            }
+        }
+
+    private:
+        struct Entry {
+            int Tick;
+            uint8_t q;
+        };
+
+        struct Chunk {
+            long long FirstTimeMs = 0;
+            long long LastTimeMs = 0;
+            int MinTick = 0x7fffffff;
+            int MaxTick = -0x7fffffff;
+
+            // price deltas start from here
+            int RefTick = 0;
+            std::vector<uint8_t> Bytes;
+        };
+
+        std::deque<Chunk> m_Chunks;
+        size_t m_MaxChunks = 1024;
+        uint8_t m_MaxQ = 0;
+
+        // last snapshot stored, and scratch space for the next one
+        std::vector<Entry> m_Prev;
+        std::vector<Entry> m_Next;
+        std::vector<Entry> m_Changes;
+
+        void DropOldChunks() {
+            while (m_Chunks.size() > m_MaxChunks) {
+                m_Chunks.pop_front();
+            }
+        }
+
+        // prices whose size differs between two sorted books, gone prices come back as 0
+        static void Diff(const std::vector<Entry> &Prev, const std::vector<Entry> &Next, std::vector<Entry> &Changes) {
+            Changes.clear();
+            size_t p = 0;
+            size_t n = 0;
+            while (p < Prev.size() || n < Next.size()) {
+                if (n == Next.size() || (p < Prev.size() && Prev[p].Tick < Next[n].Tick)) {
+                    Changes.push_back(Entry{Prev[p].Tick, 0});
+                    p++;
+                }
+                else if (p == Prev.size() || Next[n].Tick < Prev[p].Tick) {
+                    Changes.push_back(Next[n]);
+                    n++;
+                }
+                else {
+                    if (Prev[p].q != Next[n].q) {
+                        Changes.push_back(Next[n]);
+                    }
+                    p++;
+                    n++;
+                }
+            }
+        }
+
+        static uint64_t ZigZag(int v) {
+            return (uint32_t)(((uint32_t)v << 1) ^ (uint32_t)(v >> 31));
+        }
+
+        static int UnZigZag(uint64_t v) {
+            return (int)((uint32_t)(v >> 1) ^ (0u - (uint32_t)(v & 1)));
+        }
+
+        static void PutVarint(std::vector<uint8_t> &Bytes, uint64_t v) {
+            while (v >= 0x80) {
+                Bytes.push_back((uint8_t)(v | 0x80));
+                v >>= 7;
+            }
+            Bytes.push_back((uint8_t)v);
+        }
+
+        static uint64_t GetVarint(const std::vector<uint8_t> &Bytes, size_t &Pos) {
+            uint64_t v = 0;
+            int Shift = 0;
+            while (Pos < Bytes.size()) {
+                uint8_t b = Bytes[Pos++];
+                v |= (uint64_t)(b & 0x7f) << Shift;
+                if (b < 0x80) {
+                    break;
+                }
+                Shift += 7;
+            }
+            return(v);
+        }
+};
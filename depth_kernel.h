@@ -0,0 +1,111 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/*
+    Written by Frozen Tundra
+
+    Depth analytics over one side of a structure of arrays depth snapshot, in one pass:
+    average lot (0 where there are no orders), cumulative size from the inside market,
+    and which levels pass a minimum size filter. Bid/ask imbalance comes from the
+    cumulative sizes of both sides.
+
+    Built with /arch:AVX2 (or -mavx2) it does 8 levels at a time, otherwise it's plain
+    loops the compiler is free to vectorise. DepthKernelScalar is always there to compare against.
+*/
+
+struct DepthKernelSide {
+    const float *Quantity = NULL;
+
+    // NULL skips the average lot
+    const unsigned int *NumOrders = NULL;
+    float *AvgLot = NULL;
+
+    // always filled, CumQuantity[i] is the size of levels 0..i
+    float *CumQuantity = NULL;
+
+    // NULL skips the filter, otherwise 1 where Quantity >= MinimumSize
+    uint8_t *AboveMinimum = NULL;
+    float MinimumSize = 0;
+};
+
+inline void DepthKernelScalar(const DepthKernelSide &Side, int NumLevels, int First = 0, float Carry = 0)
+{
+    for (int i=First; i<NumLevels; i++) {
+        float Qty = Side.Quantity[i];
+        if (Side.AvgLot != NULL) {
+            unsigned int Orders = Side.NumOrders[i];
+            Side.AvgLot[i] = Orders > 0 ? Qty / Orders : 0;
+        }
+        Carry += Qty;
+        Side.CumQuantity[i] = Carry;
+        if (Side.AboveMinimum != NULL) {
+            Side.AboveMinimum[i] = Qty >= Side.MinimumSize;
+        }
+    }
+}
+
+#if defined(__AVX2__)
+// inclusive prefix sum of 8 floats
+inline __m256 DepthKernelPrefixSum(__m256 x)
+{
+    x = _mm256_add_ps(x, _mm256_castsi256_ps(_mm256_slli_si256(_mm256_castps_si256(x), 4)));
+    x = _mm256_add_ps(x, _mm256_castsi256_ps(_mm256_slli_si256(_mm256_castps_si256(x), 8)));
+    // carry the low 128 bit lane's total into the high lane
+    __m256 LowTotal = _mm256_permute_ps(x, _MM_SHUFFLE(3, 3, 3, 3));
+    LowTotal = _mm256_permute2f128_ps(LowTotal, LowTotal, 0x08);
+    return _mm256_add_ps(x, LowTotal);
+}
+
+inline void DepthKernelAVX2(const DepthKernelSide &Side, int NumLevels)
+{
+    const __m256 Zero = _mm256_setzero_ps();
+    const __m256 MinimumSize = _mm256_set1_ps(Side.MinimumSize);
+    __m256 Carry = Zero;
+    int i = 0;
+    for (; i + 8 <= NumLevels; i += 8) {
+        __m256 Qty = _mm256_loadu_ps(Side.Quantity + i);
+        if (Side.AvgLot != NULL) {
+            // order counts fit in an int, levels with no orders come out 0 rather than inf/nan
+            __m256 Orders = _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i *)(Side.NumOrders + i)));
+            __m256 HasOrders = _mm256_cmp_ps(Orders, Zero, _CMP_GT_OQ);
+            _mm256_storeu_ps(Side.AvgLot + i, _mm256_and_ps(_mm256_div_ps(Qty, Orders), HasOrders));
+        }
+        __m256 Cum = _mm256_add_ps(DepthKernelPrefixSum(Qty), Carry);
+        _mm256_storeu_ps(Side.CumQuantity + i, Cum);
+        Carry = _mm256_permute_ps(Cum, _MM_SHUFFLE(3, 3, 3, 3));
+        Carry = _mm256_permute2f128_ps(Carry, Carry, 0x11);
+        if (Side.AboveMinimum != NULL) {
+            int Bits = _mm256_movemask_ps(_mm256_cmp_ps(Qty, MinimumSize, _CMP_GE_OQ));
+            for (int b=0; b<8; b++) {
+                Side.AboveMinimum[i + b] = (Bits >> b) & 1;
+            }
+        }
+    }
+    // leftover levels
+    DepthKernelScalar(Side, NumLevels, i, _mm256_cvtss_f32(Carry));
+}
+#endif
+
+inline void DepthKernel(const DepthKernelSide &Side, int NumLevels)
+{
+#if defined(__AVX2__)
+    DepthKernelAVX2(Side, NumLevels);
+#else
+    DepthKernelScalar(Side, NumLevels);
+#endif
+}
+
+// (bid - ask) / (bid + ask) over the first NumLevels, -1 to 1, 0 with an empty book
+inline float DepthImbalance(const float *BidCumQuantity, const float *AskCumQuantity, int NumLevels)
+{
+    if (NumLevels <= 0) {
+        return(0);
+    }
+    float Bid = BidCumQuantity[NumLevels-1];
+    float Ask = AskCumQuantity[NumLevels-1];
+    return Bid + Ask > 0 ? (Bid - Ask) / (Bid + Ask) : 0;
+}
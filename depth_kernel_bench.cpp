@@ -0,0 +1,199 @@
+#define NOMINMAX
+#include "depth_kernel.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+using std::vector;
+using std::max;
+
+/*
+    Written by Frozen Tundra
+
+    Checks depth_kernel.h's DepthKernel against DepthKernelScalar and times both, so
+    the numbers on the kernel can be run again. Build it with and without AVX2 to see
+    both paths, without it DepthKernel is the scalar loop and the check is trivial.
+
+    Build:
+        g++ -O2 -mavx2 -std=c++17 depth_kernel_bench.cpp -o depth_kernel_bench
+        g++ -O2 -std=c++17 depth_kernel_bench.cpp -o depth_kernel_bench_scalar
+        cl /O2 /EHsc /arch:AVX2 /std:c++17 depth_kernel_bench.cpp
+
+    Usage:
+        depth_kernel_bench
+        depth_kernel_bench --bench [levels] [symbols] [iterations]
+    the first checks the two paths give the same results and exits non zero if they
+    don't, --bench also times one side of [levels] levels (100) for [symbols] books
+    (1000) [iterations] times (2000).
+*/
+
+// one side of a book with its inputs and both sets of outputs
+struct BenchSide
+{
+    vector<float> Quantity;
+    vector<unsigned int> NumOrders;
+    vector<float> AvgLot;
+    vector<float> CumQuantity;
+    vector<uint8_t> AboveMinimum;
+
+    void Resize(int NumLevels)
+    {
+        Quantity.assign(NumLevels, 0);
+        NumOrders.assign(NumLevels, 0);
+        AvgLot.assign(NumLevels, -1);
+        CumQuantity.assign(NumLevels, -1);
+        AboveMinimum.assign(NumLevels, 2);
+    }
+
+    DepthKernelSide GetSide(bool WithAvgLot, bool WithFilter, float MinimumSize)
+    {
+        DepthKernelSide Side;
+        Side.Quantity = Quantity.data();
+        Side.NumOrders = WithAvgLot ? NumOrders.data() : NULL;
+        Side.AvgLot = WithAvgLot ? AvgLot.data() : NULL;
+        Side.CumQuantity = CumQuantity.data();
+        Side.AboveMinimum = WithFilter ? AboveMinimum.data() : NULL;
+        Side.MinimumSize = MinimumSize;
+        return(Side);
+    }
+};
+
+// random book, whole lots like futures or fractional like crypto. some levels are empty
+void FillSide(BenchSide& Side, int NumLevels, bool Fractional, std::mt19937& Random)
+{
+    Side.Resize(NumLevels);
+    for (int i=0; i<NumLevels; i++)
+    {
+        unsigned int Orders = Random() % 8 == 0 ? 0 : 1 + Random() % 40;
+        float Qty = Orders == 0 ? 0 : (float)(1 + Random() % 500);
+        if (Fractional && Orders > 0)
+        {
+            Qty = Qty / 7.0f + (Random() % 1000) / 1000.0f;
+        }
+        Side.Quantity[i] = Qty;
+        Side.NumOrders[i] = Orders;
+    }
+}
+
+int Check()
+{
+    std::mt19937 Random(12345);
+    int NumFailed = 0;
+    int NumCases = 0;
+    for (int NumLevels=0; NumLevels<=70; NumLevels++)
+    {
+        for (int Case=0; Case<8; Case++)
+        {
+            bool Fractional = (Case & 1) != 0;
+            bool WithAvgLot = (Case & 2) != 0;
+            bool WithFilter = (Case & 4) != 0;
+            float MinimumSize = (float)(Random() % 300);
+
+            BenchSide Kernel;
+            FillSide(Kernel, NumLevels, Fractional, Random);
+            BenchSide Scalar = Kernel;
+            DepthKernel(Kernel.GetSide(WithAvgLot, WithFilter, MinimumSize), NumLevels);
+            DepthKernelScalar(Scalar.GetSide(WithAvgLot, WithFilter, MinimumSize), NumLevels);
+            NumCases++;
+
+            // avg lot and the filter are the same math per level, whole lot sums are exact in a float.
+            // fractional sums are added in a different order so they can be off in the last bits
+            bool Same = Kernel.AvgLot == Scalar.AvgLot && Kernel.AboveMinimum == Scalar.AboveMinimum;
+            for (int i=0; Same && i<NumLevels; i++)
+            {
+                float Diff = fabsf(Kernel.CumQuantity[i] - Scalar.CumQuantity[i]);
+                Same = Fractional ? Diff <= 1e-5f * max(Scalar.CumQuantity[i], 1.0f) : Diff == 0;
+            }
+            if (!Same)
+            {
+                fprintf(stderr, "FAILED %d levels, %s, avg lot %d, filter %d\n", NumLevels, Fractional ? "fractional" : "whole lots", WithAvgLot, WithFilter);
+                NumFailed++;
+            }
+        }
+    }
+
+    // imbalance edges
+    float Bid[] = { 10, 30 };
+    float Ask[] = { 10, 10 };
+    float Empty[] = { 0, 0 };
+    if (DepthImbalance(Bid, Ask, 0) != 0 || DepthImbalance(Bid, Ask, 1) != 0 || DepthImbalance(Bid, Ask, 2) != 0.5f || DepthImbalance(Empty, Empty, 2) != 0)
+    {
+        fprintf(stderr, "FAILED DepthImbalance\n");
+        NumFailed++;
+    }
+
+    if (NumFailed > 0)
+    {
+        fprintf(stderr, "%d of %d cases failed\n", NumFailed, NumCases + 1);
+        return(1);
+    }
+#if defined(__AVX2__)
+    printf("avx2 kernel matches scalar, %d cases\n", NumCases + 1);
+#else
+    printf("built without avx2, kernel is the scalar loop, %d cases\n", NumCases + 1);
+#endif
+    return(0);
+}
+
+// ns per side of NumLevels levels, Kernel picks DepthKernel or DepthKernelScalar
+double TimeKernel(vector<BenchSide>& Books, int NumLevels, int NumIterations, bool Kernel, double& Checksum)
+{
+    auto Start = std::chrono::steady_clock::now();
+    for (int n=0; n<NumIterations; n++)
+    {
+        for (BenchSide &Book : Books)
+        {
+            DepthKernelSide Side = Book.GetSide(true, true, 100);
+            if (Kernel)
+            {
+                DepthKernel(Side, NumLevels);
+            }
+            else
+            {
+                DepthKernelScalar(Side, NumLevels);
+            }
+        }
+        Checksum += Books[n % Books.size()].CumQuantity[NumLevels-1];
+    }
+    double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+    return(Seconds * 1e9 / ((double)NumIterations * Books.size()));
+}
+
+int RunBenchmark(int NumLevels, int NumSymbols, int NumIterations)
+{
+    std::mt19937 Random(777);
+    vector<BenchSide> Books(NumSymbols);
+    for (BenchSide &Book : Books)
+    {
+        FillSide(Book, NumLevels, false, Random);
+    }
+
+    // the sum keeps the compiler from dropping the work
+    double Checksum = 0;
+    printf("%d levels x %d symbols x %d iterations\n", NumLevels, NumSymbols, NumIterations);
+#if defined(__AVX2__)
+    printf("%-24s %10.1f ns per side\n", "avx2 kernel", TimeKernel(Books, NumLevels, NumIterations, true, Checksum));
+    printf("%-24s %10.1f ns per side\n", "scalar, same build", TimeKernel(Books, NumLevels, NumIterations, false, Checksum));
+#else
+    printf("%-24s %10.1f ns per side\n", "scalar (no avx2)", TimeKernel(Books, NumLevels, NumIterations, true, Checksum));
+#endif
+    printf("checksum %g\n", Checksum);
+    return(0);
+}
+
+int main(int argc, char** argv)
+{
+    int Result = Check();
+    if (Result != 0 || argc < 2 || strcmp(argv[1], "--bench") != 0)
+    {
+        return(Result);
+    }
+    int NumLevels = argc >= 3 ? max(atoi(argv[2]), 1) : 100;
+    int NumSymbols = argc >= 4 ? max(atoi(argv[3]), 1) : 1000;
+    int NumIterations = argc >= 5 ? max(atoi(argv[4]), 1) : 2000;
+    return(RunBenchmark(NumLevels, NumSymbols, NumIterations));
+}
@@ -0,0 +1,168 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+/*
+    Written by Frozen Tundra
+
+    Ring of recent depth snapshots, top N levels a side, for looking up how much size
+    was showing at a price just before a print. Fixed memory, snapshots are captured
+    on depth updates and looked up by time with a binary search, so nothing has to
+    query depth from inside a print loop. Doesn't need sierrachart.h.
+
+    Times are whatever clock the caller stamps snapshots with, lookups have to be on
+    the same clock. Stamping with the time of the last print seen gets it wrong when
+    a depth update comes in ahead of the print that caused it.
+*/
+
+const int DEPTH_RING_BID = 0;
+const int DEPTH_RING_ASK = 1;
+
+const int DEPTH_RING_DEFAULT_CAPACITY = 4096;
+
+class DepthRing
+{
+    public:
+        // clears the ring if anything changed
+        void Configure(int NumLevels, float TickSize, int Capacity = DEPTH_RING_DEFAULT_CAPACITY)
+        {
+            if (NumLevels == m_NumLevels && TickSize == m_TickSize && Capacity == m_Capacity)
+            {
+                return;
+            }
+            m_NumLevels = NumLevels > 0 ? NumLevels : 0;
+            m_TickSize = TickSize;
+            m_Capacity = Capacity > 0 ? Capacity : 1;
+            m_Times.assign(m_Capacity, 0);
+            m_Ticks.assign((size_t)m_Capacity * m_NumLevels * 2, 0);
+            m_Sizes.assign((size_t)m_Capacity * m_NumLevels * 2, 0);
+            m_NumAdded = 0;
+        }
+
+        void Clear()
+        {
+            m_NumAdded = 0;
+        }
+
+        bool IsEnabled() const { return m_NumLevels > 0 && m_TickSize > 0; }
+
+        int Size() const { return m_NumAdded < m_Capacity ? (int)m_NumAdded : m_Capacity; }
+
+        // capture the top levels, skipped if nothing changed since the last one
+        bool Add(long long TimeMs, const float *BidPrice, const float *BidQty,
+            const float *AskPrice, const float *AskQty, int NumLevels)
+        {
+            if (!IsEnabled())
+            {
+                return(false);
+            }
+            // build it on the side, when the ring is full the next slot is still the oldest snapshot
+            m_NextTicks.resize((size_t)m_NumLevels * 2);
+            m_NextSizes.resize((size_t)m_NumLevels * 2);
+            int *p_Ticks = m_NextTicks.data();
+            float *p_Sizes = m_NextSizes.data();
+            const float *Prices[2] = {BidPrice, AskPrice};
+            const float *Sizes[2] = {BidQty, AskQty};
+            for (int Side=0; Side<2; Side++)
+            {
+                for (int i=0; i<m_NumLevels; i++)
+                {
+                    bool HasLevel = i < NumLevels && Prices[Side][i] > 0;
+                    p_Ticks[Side * m_NumLevels + i] = HasLevel ? (int)lround(Prices[Side][i] / m_TickSize) : 0;
+                    p_Sizes[Side * m_NumLevels + i] = HasLevel ? Sizes[Side][i] : 0;
+                }
+            }
+
+            // times only go forward so the lookup can binary search
+            if (m_NumAdded > 0 && TimeMs < m_Times[GetSlot(Size() - 1)])
+            {
+                TimeMs = m_Times[GetSlot(Size() - 1)];
+            }
+
+            // same book as the newest snapshot, keep the older time
+            if (m_NumAdded > 0 && IsSameAsNewest(p_Ticks, p_Sizes))
+            {
+                return(false);
+            }
+            int Slot = (int)(m_NumAdded % m_Capacity);
+            std::copy(m_NextTicks.begin(), m_NextTicks.end(), m_Ticks.begin() + (size_t)Slot * m_NumLevels * 2);
+            std::copy(m_NextSizes.begin(), m_NextSizes.end(), m_Sizes.begin() + (size_t)Slot * m_NumLevels * 2);
+            m_Times[Slot] = TimeMs;
+            m_NumAdded++;
+            return(true);
+        }
+
+        // newest snapshot taken strictly before TimeMs, 0 is the oldest, -1 if there isn't one
+        int FindBefore(long long TimeMs) const
+        {
+            int Lo = 0;
+            int Hi = Size();
+            while (Lo < Hi)
+            {
+                int Mid = Lo + (Hi - Lo) / 2;
+                if (m_Times[GetSlot(Mid)] < TimeMs)
+                {
+                    Lo = Mid + 1;
+                }
+                else
+                {
+                    Hi = Mid;
+                }
+            }
+            return(Lo - 1);
+        }
+
+        long long GetTime(int Index) const { return m_Times[GetSlot(Index)]; }
+
+        // size showing at a price in a snapshot, 0 if the price wasn't in the top levels
+        float GetSize(int Index, int Side, float Price) const
+        {
+            if (Index < 0 || Index >= Size() || !IsEnabled())
+            {
+                return(0);
+            }
+            int Tick = (int)lround(Price / m_TickSize);
+            size_t First = ((size_t)GetSlot(Index) * 2 + Side) * m_NumLevels;
+            for (int i=0; i<m_NumLevels; i++)
+            {
+                if (m_Ticks[First + i] == Tick)
+                {
+                    return m_Sizes[First + i];
+                }
+            }
+            return(0);
+        }
+
+    private:
+        int m_NumLevels = 0;
+        float m_TickSize = 0;
+        int m_Capacity = 0;
+        long long m_NumAdded = 0;
+
+        // one time per snapshot, ticks and sizes are [snapshot][side][level]
+        std::vector<long long> m_Times;
+        std::vector<int> m_Ticks;
+        std::vector<float> m_Sizes;
+        std::vector<int> m_NextTicks;
+        std::vector<float> m_NextSizes;
+
+        int GetSlot(int Index) const
+        {
+            long long First = m_NumAdded - Size();
+            return (int)((First + Index) % m_Capacity);
+        }
+
+        bool IsSameAsNewest(const int *p_Ticks, const float *p_Sizes) const
+        {
+            size_t Newest = (size_t)GetSlot(Size() - 1) * m_NumLevels * 2;
+            for (int i=0; i<m_NumLevels * 2; i++)
+            {
+                if (m_Ticks[Newest + i] != p_Ticks[i] || m_Sizes[Newest + i] != p_Sizes[i])
+                {
+                    return(false);
+                }
+            }
+            return(true);
+        }
+};
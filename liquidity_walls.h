@@ -0,0 +1,336 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <cmath>
+#include <cstdlib>
+
+/*
+    Written by Frozen Tundra
+
+    Liquidity wall tracker. A wall is a resting order that's large compared to what
+    this symbol normally shows, judged against a rolling distribution of level sizes.
+
+    Walls are keyed by price (in ticks) and followed from one depth update to the next,
+    including when they hop a few ticks or shrink. When one goes away we keep its
+    lifetime, peak size, and whether it was traded through or pulled.
+    Doesn't need sierrachart.h.
+*/
+
+const int WALL_BID = 0;
+const int WALL_ASK = 1;
+
+enum WallOutcome
+{
+    WALL_ACTIVE,
+    WALL_PULLED,
+    WALL_TRADED_THROUGH
+};
+
+// log scale size bins for the rolling distribution, 8 bins per doubling
+const int WALL_NUM_BINS = 256;
+const float WALL_BINS_PER_DOUBLING = 8.0f;
+
+// a wall stays tracked until it drops below this fraction of the wall threshold
+const float WALL_KEEP_FRACTION = 0.5f;
+
+// a wall that vanished and reappeared within this many ticks at a similar size moved
+const int WALL_MAX_MOVE_TICKS = 4;
+
+// finished walls kept for reporting
+const size_t WALL_HISTORY_SIZE = 200;
+
+struct LiquidityWall
+{
+    int Id = 0;
+    int Side = WALL_BID;
+    int Tick = 0;
+    float Qty = 0;
+    float PeakQty = 0;
+    long long StartMs = 0;
+    long long EndMs = 0;
+    int NumMoves = 0;
+    WallOutcome Outcome = WALL_ACTIVE;
+
+    // executions at the wall's price since the last update
+    float PendingTraded = 0;
+
+    // last update the wall was still there
+    unsigned int Seen = 0;
+
+    long long GetLifetimeMs(long long NowMs) const { return (Outcome == WALL_ACTIVE ? NowMs : EndMs) - StartMs; }
+};
+
+struct WallLevel
+{
+    int Tick;
+    float Qty;
+};
+
+class LiquidityWallTracker
+{
+    public:
+        // walls are the top (100 - Percentile)% of level sizes seen, and never below MinimumSize
+        void Configure(float Percentile, float MinimumSize, float HalfLifeSeconds)
+        {
+            m_Percentile = Percentile;
+            m_MinimumSize = MinimumSize;
+            m_HalfLifeSeconds = HalfLifeSeconds > 0 ? HalfLifeSeconds : 1;
+        }
+
+        void Clear()
+        {
+            m_Active.clear();
+            m_History.clear();
+            for (int i=0; i<WALL_NUM_BINS; i++)
+            {
+                m_Bins[i] = 0;
+            }
+            m_Total = 0;
+            m_LastDecayMs = 0;
+            m_Threshold = 0;
+        }
+
+        float GetThreshold() const { return m_Threshold; }
+
+        // walls still resting, keyed by side and price
+        const std::unordered_map<long long, LiquidityWall>& GetActive() const { return m_Active; }
+
+        // the wall resting at this price, NULL if there isn't one
+        const LiquidityWall* Find(int Side, int Tick) const
+        {
+            auto Found = m_Active.find(Key(Side, Tick));
+            return Found != m_Active.end() ? &Found->second : NULL;
+        }
+
+        // walls that went away, oldest first
+        const std::deque<LiquidityWall>& GetHistory() const { return m_History; }
+
+        // executions since the last Update(), Side is the side of the book that got hit
+        void AddTrade(int Tick, float Volume, int Side)
+        {
+            auto Found = m_Active.find(Key(Side, Tick));
+            if (Found != m_Active.end())
+            {
+                Found->second.PendingTraded += Volume;
+            }
+        }
+
+        // one side's levels, inside market first. returns walls that ended in this update.
+        int Update(long long NowMs, int Side, const WallLevel *Levels, int NumLevels)
+        {
+            int NumEnded = 0;
+            if (NumLevels <= 0)
+            {
+                return(0);
+            }
+            AddToDistribution(NowMs, Levels, NumLevels);
+            float Keep = m_Threshold * WALL_KEEP_FRACTION;
+            int InsideTick = Levels[0].Tick;
+            int DeepestTick = Levels[NumLevels-1].Tick;
+
+            // walls still at their price and not shrunk below the keep level
+            m_Stamp++;
+            for (int i=0; i<NumLevels; i++)
+            {
+                if (Levels[i].Qty < Keep)
+                {
+                    continue;
+                }
+                auto Found = m_Active.find(Key(Side, Levels[i].Tick));
+                if (Found != m_Active.end())
+                {
+                    SetQty(Found->second, Levels[i].Qty);
+                    Found->second.PendingTraded = 0;
+                    Found->second.Seen = m_Stamp;
+                }
+            }
+            m_Gone.clear();
+            for (auto it=m_Active.begin(); it!=m_Active.end(); ++it)
+            {
+                if (it->second.Side == Side && it->second.Seen != m_Stamp)
+                {
+                    m_Gone.push_back(it->first);
+                }
+            }
+
+            // new walls, either fresh or one that just hopped a few ticks
+            for (int i=0; i<NumLevels; i++)
+            {
+                if (Levels[i].Qty < m_Threshold || m_Active.count(Key(Side, Levels[i].Tick)) > 0)
+                {
+                    continue;
+                }
+                long long MovedKey = FindMoved(Side, Levels[i]);
+                if (MovedKey != 0)
+                {
+                    LiquidityWall Wall = m_Active[MovedKey];
+                    m_Active.erase(MovedKey);
+                    RemoveGone(MovedKey);
+                    Wall.Tick = Levels[i].Tick;
+                    Wall.NumMoves++;
+                    Wall.PendingTraded = 0;
+                    Wall.Seen = m_Stamp;
+                    SetQty(Wall, Levels[i].Qty);
+                    m_Active[Key(Side, Wall.Tick)] = Wall;
+                    continue;
+                }
+                LiquidityWall Wall;
+                Wall.Id = ++m_NextId;
+                Wall.Side = Side;
+                Wall.Tick = Levels[i].Tick;
+                Wall.StartMs = NowMs;
+                Wall.Seen = m_Stamp;
+                SetQty(Wall, Levels[i].Qty);
+                m_Active[Key(Side, Wall.Tick)] = Wall;
+            }
+
+            // whatever is left really went away
+            for (size_t g=0; g<m_Gone.size(); g++)
+            {
+                auto Found = m_Active.find(m_Gone[g]);
+                if (Found == m_Active.end())
+                {
+                    continue;
+                }
+                LiquidityWall Wall = Found->second;
+                m_Active.erase(Found);
+
+                // past the deepest level we read isn't an ending, we just can't see it anymore
+                bool OutOfView = Side == WALL_BID ? Wall.Tick < DeepestTick : Wall.Tick > DeepestTick;
+                if (OutOfView)
+                {
+                    continue;
+                }
+
+                // traded through if the market went through its price, or prints ate most of it
+                bool Crossed = Side == WALL_BID ? InsideTick < Wall.Tick : InsideTick > Wall.Tick;
+                Wall.Outcome = Crossed || Wall.PendingTraded >= Wall.Qty * 0.5f ? WALL_TRADED_THROUGH : WALL_PULLED;
+                Wall.EndMs = NowMs;
+                m_History.push_back(Wall);
+                if (m_History.size() > WALL_HISTORY_SIZE)
+                {
+                    m_History.pop_front();
+                }
+                NumEnded++;
+            }
+            return(NumEnded);
+        }
+
+    private:
+        std::unordered_map<long long, LiquidityWall> m_Active;
+        std::deque<LiquidityWall> m_History;
+        std::vector<long long> m_Gone;
+        unsigned int m_Stamp = 0;
+        int m_NextId = 0;
+
+        // exponentially decayed histogram of level sizes
+        float m_Bins[WALL_NUM_BINS] = {};
+        float m_Total = 0;
+        long long m_LastDecayMs = 0;
+        float m_Threshold = 0;
+
+        float m_Percentile = 98;
+        float m_MinimumSize = 0;
+        float m_HalfLifeSeconds = 300;
+
+        static long long Key(int Side, int Tick)
+        {
+            return ((long long)(Side + 1) << 32) | (unsigned int)Tick;
+        }
+
+        static void SetQty(LiquidityWall &Wall, float Qty)
+        {
+            Wall.Qty = Qty;
+            if (Qty > Wall.PeakQty)
+            {
+                Wall.PeakQty = Qty;
+            }
+        }
+
+        void RemoveGone(long long WallKey)
+        {
+            for (size_t g=0; g<m_Gone.size(); g++)
+            {
+                if (m_Gone[g] == WallKey)
+                {
+                    m_Gone[g] = 0;
+                }
+            }
+        }
+
+        // a wall on the same side that left its price in this update with a similar size
+        long long FindMoved(int Side, const WallLevel &Level) const
+        {
+            long long Best = 0;
+            int BestDistance = WALL_MAX_MOVE_TICKS + 1;
+            for (size_t g=0; g<m_Gone.size(); g++)
+            {
+                auto Found = m_Active.find(m_Gone[g]);
+                if (Found == m_Active.end() || Found->second.Side != Side)
+                {
+                    continue;
+                }
+                const LiquidityWall &Wall = Found->second;
+                int Distance = std::abs(Wall.Tick - Level.Tick);
+                if (Distance < BestDistance && Level.Qty >= Wall.Qty * 0.5f && Level.Qty <= Wall.Qty * 2)
+                {
+                    Best = m_Gone[g];
+                    BestDistance = Distance;
+                }
+            }
+            return(Best);
+        }
+
+        static int GetBin(float Qty)
+        {
+            int Bin = (int)(log2f(1 + Qty) * WALL_BINS_PER_DOUBLING);
+            return Bin < 0 ? 0 : (Bin >= WALL_NUM_BINS ? WALL_NUM_BINS - 1 : Bin);
+        }
+
+        static float GetBinSize(int Bin)
+        {
+            return exp2f(Bin / WALL_BINS_PER_DOUBLING) - 1;
+        }
+
+        // decay the distribution by elapsed time, add this update's levels, and move the threshold
+        void AddToDistribution(long long NowMs, const WallLevel *Levels, int NumLevels)
+        {
+            if (m_LastDecayMs > 0 && NowMs > m_LastDecayMs)
+            {
+                float Decay = exp2f(-(NowMs - m_LastDecayMs) / (m_HalfLifeSeconds * 1000));
+                for (int i=0; i<WALL_NUM_BINS; i++)
+                {
+                    m_Bins[i] *= Decay;
+                }
+                m_Total *= Decay;
+            }
+            m_LastDecayMs = NowMs;
+            for (int i=0; i<NumLevels; i++)
+            {
+                if (Levels[i].Qty > 0)
+                {
+                    m_Bins[GetBin(Levels[i].Qty)] += 1;
+                    m_Total += 1;
+                }
+            }
+
+            // walk down from the largest bin until we've covered the top slice
+            float Target = m_Total * (100 - m_Percentile) / 100;
+            float Above = 0;
+            int Bin = WALL_NUM_BINS - 1;
+            for (; Bin > 0; Bin--)
+            {
+                Above += m_Bins[Bin];
+                if (Above >= Target)
+                {
+                    break;
+                }
+            }
+            m_Threshold = GetBinSize(Bin);
+            if (m_Threshold < m_MinimumSize)
+            {
+                m_Threshold = m_MinimumSize;
+            }
+        }
+};
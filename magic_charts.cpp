@@ -1,4 +1,11 @@
 #include "sierrachart.h"
+#include "scid_reader.h"
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 SCDLLName("Frozen Tundra - Magic Executions")
 using std::unordered_map;
 using std::vector;
@@ -10,6 +17,893 @@ using std::vector;
 // function prototype declaration
 void DrawToChart(HWND WindowHandle, HDC DeviceContext, SCStudyInterfaceRef sc);
 
+// compact copy of the parts of an s_IntradayRecord the drawing needs
+struct MagicTick
+{
+    // price as a multiple of sc.TickSize
+    int PriceInTicks;
+    unsigned int Volume;
+    unsigned int BidVolume;
+    unsigned int AskVolume;
+    // milliseconds since the start of the bar
+    unsigned int MsOffset;
+    // position within the bar's time span, 0 = bar start, 65535 = bar end
+    unsigned short XFraction;
+};
+
+// milliseconds from one datetime to another
+long long GetMsBetween(const SCDateTime& From, const SCDateTime& To)
+{
+    return (long long)(To.GetDate() - From.GetDate()) * 86400000
+        + To.GetTimeInMilliseconds() - From.GetTimeInMilliseconds();
+}
+
+MagicTick MakeTick(const s_IntradayRecord& IntradayRecord, const SCDateTime& BarStart, float TickSize)
+{
+    MagicTick Tick;
+    Tick.PriceInTicks = (int)floor(IntradayRecord.GetClose() / TickSize + 0.5f);
+    Tick.Volume = IntradayRecord.TotalVolume;
+    Tick.BidVolume = IntradayRecord.BidVolume;
+    Tick.AskVolume = IntradayRecord.AskVolume;
+    Tick.MsOffset = (unsigned int)max(GetMsBetween(BarStart, IntradayRecord.DateTime), 0LL);
+    Tick.XFraction = 0;
+    return(Tick);
+}
+
+// place ticks by timestamp within the bar, SpanMs <= 0 stretches the bar to its newest tick
+void LayoutTicks(MagicTick* Ticks, int NumTicks, long long SpanMs)
+{
+    if (SpanMs <= 0 && NumTicks > 0)
+    {
+        SpanMs = Ticks[NumTicks-1].MsOffset;
+    }
+    SpanMs = max(SpanMs, 1LL);
+    for (int i=0; i<NumTicks; i++)
+    {
+        Ticks[i].XFraction = (unsigned short)min((long long)Ticks[i].MsOffset * 65535 / SpanMs, 65535LL);
+    }
+}
+
+// single pass downsampler for one bar's trades.
+// large prints are always kept. the rest of the budget is split evenly across the
+// (time slice, price row) cells that saw trades, each cell keeps a reservoir sample.
+// the cell table is flat and sized in Reset(), price levels are merged into rows so there
+// are never more cells than the budget, and every cell's trades sit in one shared arena.
+// Add() doesn't hash or allocate a vector per cell, it runs while the intraday file is locked.
+struct TickSampler
+{
+    static const int NUM_TIME_SLICES = 8;
+
+    struct Cell
+    {
+        unsigned int Seen = 0;
+        // kept trades are Arena[Offset, Offset+Count), -1 until the cell's first trade
+        int Offset = -1;
+        int Count = 0;
+    };
+
+    // 0 keeps everything
+    int Budget = 0;
+    unsigned int LargeThreshold = 0;
+    unsigned int SliceMs = 1;
+    int NumSlices = 1;
+
+    // price in ticks => row, TicksPerRow neighbouring levels share one
+    int LowTick = 0;
+    int TicksPerRow = 1;
+    int NumRows = 1;
+
+    vector<MagicTick> Large;
+    // NumSlices x NumRows, slice major
+    vector<Cell> Cells;
+    // cells that saw trades, in the order they did
+    vector<int> ActiveCells;
+    // a cell gets room for the capacity it had on its first trade, capacity only goes down after that
+    vector<MagicTick> Arena;
+    int CellCapacity = 0;
+    unsigned int RandomState = 1;
+
+    // Low/High/TickSize give the price rows. the live bar's range can still grow, prices past it go in the edge rows
+    void Reset(int BudgetIn, unsigned int LargeThresholdIn, long long BarMs, float Low, float High, float TickSize)
+    {
+        Budget = BudgetIn;
+        LargeThreshold = LargeThresholdIn;
+        Large.clear();
+        ActiveCells.clear();
+        Arena.clear();
+        CellCapacity = 0;
+        RandomState = 1;
+        if (Budget <= 0)
+        {
+            Cells.clear();
+            return;
+        }
+
+        NumSlices = min(NUM_TIME_SLICES, Budget);
+        SliceMs = (unsigned int)max(BarMs / NumSlices, 1LL);
+        int NumLevels = 1;
+        LowTick = 0;
+        if (TickSize > 0)
+        {
+            LowTick = (int)floor(Low / TickSize + 0.5f);
+            NumLevels = max((int)floor(High / TickSize + 0.5f) - LowTick + 1, 1);
+        }
+        int MaxRows = max(Budget / NumSlices, 1);
+        TicksPerRow = (NumLevels + MaxRows - 1) / MaxRows;
+        NumRows = (NumLevels + TicksPerRow - 1) / TicksPerRow;
+        Cells.assign(NumSlices * NumRows, Cell());
+        Arena.reserve(Budget);
+    }
+
+    // xorshift, deterministic so the same bar samples the same way every time
+    unsigned int Random()
+    {
+        RandomState ^= RandomState << 13;
+        RandomState ^= RandomState >> 17;
+        RandomState ^= RandomState << 5;
+        return(RandomState);
+    }
+
+    void Add(const MagicTick& Tick)
+    {
+        if (Budget <= 0 || (LargeThreshold > 0 && Tick.Volume >= LargeThreshold))
+        {
+            Large.push_back(Tick);
+            return;
+        }
+
+        int Slice = min((int)(Tick.MsOffset / SliceMs), NumSlices - 1);
+        int Row = min(max((Tick.PriceInTicks - LowTick) / TicksPerRow, 0), NumRows - 1);
+        int CellIdx = Slice * NumRows + Row;
+        if (Cells[CellIdx].Offset < 0)
+        {
+            ActiveCells.push_back(CellIdx);
+        }
+
+        // budget left after large prints, there are never more cells than the budget
+        // so every cell keeps at least one trade until large prints use it up
+        int Capacity = max(Budget - (int)Large.size(), 0) / (int)ActiveCells.size();
+        if (Capacity < CellCapacity)
+        {
+            Shrink(Capacity);
+        }
+        CellCapacity = Capacity;
+
+        Cell &CurrCell = Cells[CellIdx];
+        if (CurrCell.Offset < 0)
+        {
+            CurrCell.Offset = (int)Arena.size();
+            Arena.resize(Arena.size() + Capacity);
+        }
+
+        // reservoir sampling within the cell
+        CurrCell.Seen++;
+        if (CurrCell.Count < Capacity)
+        {
+            Arena[CurrCell.Offset + CurrCell.Count++] = Tick;
+        }
+        else
+        {
+            unsigned int Pick = Random() % CurrCell.Seen;
+            if (Pick < (unsigned int)Capacity)
+            {
+                Arena[CurrCell.Offset + Pick] = Tick;
+            }
+        }
+    }
+
+    // more cells than before, randomly drop kept trades so each cell fits the new capacity
+    void Shrink(int Capacity)
+    {
+        for (int CellIdx : ActiveCells)
+        {
+            Cell &CurrCell = Cells[CellIdx];
+            MagicTick *Kept = Arena.data() + CurrCell.Offset;
+            while (CurrCell.Count > Capacity)
+            {
+                Kept[Random() % CurrCell.Count] = Kept[CurrCell.Count - 1];
+                CurrCell.Count--;
+            }
+        }
+    }
+
+    // everything kept, oldest first
+    void GetSample(vector<MagicTick>& Sample)
+    {
+        Sample = Large;
+        for (int CellIdx : ActiveCells)
+        {
+            const Cell &CurrCell = Cells[CellIdx];
+            Sample.insert(Sample.end(), Arena.begin() + CurrCell.Offset, Arena.begin() + CurrCell.Offset + CurrCell.Count);
+        }
+        std::stable_sort(Sample.begin(), Sample.end(), [](const MagicTick& a, const MagicTick& b) { return a.MsOffset < b.MsOffset; });
+    }
+};
+
+// one price level of a bar, or the whole bar for the summary glyph
+struct PriceAggregate
+{
+    int PriceInTicks;
+    unsigned int Volume;
+    // ask volume minus bid volume
+    long long NetVolume;
+};
+
+// level of detail, picked by how many pixels a bar gets on screen
+enum MagicLodTier
+{
+    LOD_FULL,
+    LOD_SUBSET,
+    LOD_LEVELS,
+    LOD_SUMMARY
+};
+
+// pixels per bar needed for each tier, anything narrower gets the summary glyph
+const int LOD_FULL_MIN_PIXELS = 40;
+const int LOD_SUBSET_MIN_PIXELS = 15;
+const int LOD_LEVELS_MIN_PIXELS = 5;
+
+// subset keeps every large print plus one in this many of the rest
+const int LOD_SUBSET_RATIO = 4;
+
+// coarser views of a bar's ticks, built the first time a zoom level needs them
+struct BarLod
+{
+    bool Built = false;
+    vector<MagicTick> Subset;
+    // one entry per price the bar traded at
+    vector<PriceAggregate> Levels;
+    // whole bar at its volume weighted price
+    PriceAggregate Summary = { 0, 0, 0 };
+};
+
+// where a bar's ticks live in the arena
+struct BarSlot
+{
+    unsigned int Offset = 0;
+    unsigned int Count = 0;
+
+    // next SubIndex to read from the intraday file for this bar
+    int NextSubIndex = 0;
+
+    // bar has closed and was read to the end, its ticks can never change
+    bool Complete = false;
+
+    // handed to the prefetch worker
+    bool Prefetching = false;
+
+    // rebuilt lazily whenever the bar's ticks change
+    BarLod Lod;
+};
+
+// running update/paint durations, logged every LOG_EVERY calls
+struct MagicTiming
+{
+    static const int LOG_EVERY = 100;
+
+    int Count = 0;
+    double TotalMs = 0;
+    double MaxMs = 0;
+    long long TotalRecords = 0;
+
+    void Add(SCStudyInterfaceRef sc, const char* Name, std::chrono::steady_clock::time_point Start, int NumRecords = 0)
+    {
+        double Ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count();
+        Count++;
+        TotalMs += Ms;
+        MaxMs = max(MaxMs, Ms);
+        TotalRecords += NumRecords;
+        if (Count >= LOG_EVERY)
+        {
+            SCString msg;
+            if (TotalRecords > 0)
+            {
+                msg.Format("Magic %s: avg=%.2fms max=%.2fms over %d calls, %lld records per call", Name, TotalMs / Count, MaxMs, Count, TotalRecords / Count);
+            }
+            else
+            {
+                msg.Format("Magic %s: avg=%.2fms max=%.2fms over %d calls", Name, TotalMs / Count, MaxMs, Count);
+            }
+            sc.AddMessageToLog(msg, 0);
+            Count = 0;
+            TotalMs = 0;
+            MaxMs = 0;
+            TotalRecords = 0;
+        }
+    }
+};
+
+// closed bar for the prefetch worker to read
+struct PrefetchRequest
+{
+    int BarIdx;
+    unsigned int Generation;
+
+    // intraday file time range to read, [FileStart, FileEnd)
+    SCDateTime FileStart;
+    SCDateTime FileEnd;
+    long long BarMs;
+
+    float High;
+    float Low;
+    float TickSize;
+    int Budget;
+    unsigned int LargeThreshold;
+};
+
+struct PrefetchResult
+{
+    int BarIdx;
+    unsigned int Generation;
+    // false if the file couldn't be read, the bar is left for the chart thread
+    bool Success;
+    vector<MagicTick> Ticks;
+};
+
+// background worker reading bars next to the visible range before they scroll into view.
+// ACSIL functions are only safe on the chart thread, so the worker maps the .scid file itself.
+// the chart thread only queues requests and picks up finished results.
+struct MagicPrefetcher
+{
+    // oldest requests are dropped once the queue is full
+    static const size_t MAX_QUEUE = 64;
+
+    std::thread Worker;
+    std::mutex Mutex;
+    std::condition_variable Wake;
+    std::deque<PrefetchRequest> Queue;
+    vector<PrefetchResult> Ready;
+    std::string FilePath;
+    unsigned int Generation = 0;
+    bool Stop = false;
+
+    ~MagicPrefetcher()
+    {
+        {
+            std::lock_guard<std::mutex> Lock(Mutex);
+            Stop = true;
+        }
+        Wake.notify_one();
+        if (Worker.joinable())
+        {
+            Worker.join();
+        }
+    }
+
+    // drop everything queued or in flight, results already computed are ignored
+    void Cancel()
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        Generation++;
+        Queue.clear();
+        Ready.clear();
+    }
+
+    unsigned int GetGeneration()
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        return(Generation);
+    }
+
+    void SetFile(const std::string& Path)
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        if (Path != FilePath)
+        {
+            FilePath = Path;
+            Generation++;
+            Queue.clear();
+            Ready.clear();
+        }
+    }
+
+    // returns the bar of a request that won't be read after all (this one if it's stale,
+    // or the oldest one dropped to make room), -1 if none. its slot can be requested again.
+    int Request(const PrefetchRequest& Req)
+    {
+        int DroppedBarIdx = -1;
+        {
+            std::lock_guard<std::mutex> Lock(Mutex);
+            if (Req.Generation != Generation)
+            {
+                return(Req.BarIdx);
+            }
+            if (Queue.size() >= MAX_QUEUE)
+            {
+                DroppedBarIdx = Queue.front().BarIdx;
+                Queue.pop_front();
+            }
+            Queue.push_back(Req);
+        }
+        if (!Worker.joinable())
+        {
+            Worker = std::thread(&MagicPrefetcher::Run, this);
+        }
+        Wake.notify_one();
+        return(DroppedBarIdx);
+    }
+
+    // chart thread, grab whatever is finished without waiting on the worker
+    void TakeReady(vector<PrefetchResult>& Results)
+    {
+        Results.clear();
+        std::unique_lock<std::mutex> Lock(Mutex, std::try_to_lock);
+        if (Lock.owns_lock())
+        {
+            Results.swap(Ready);
+        }
+    }
+
+    void Run()
+    {
+        std::unique_lock<std::mutex> Lock(Mutex);
+        while (true)
+        {
+            Wake.wait(Lock, [this] { return Stop || !Queue.empty(); });
+            if (Stop)
+            {
+                return;
+            }
+            PrefetchRequest Req = Queue.front();
+            Queue.pop_front();
+            std::string Path = FilePath;
+
+            Lock.unlock();
+            PrefetchResult Result;
+            Result.BarIdx = Req.BarIdx;
+            Result.Generation = Req.Generation;
+            Result.Success = ReadBar(Path, Req, Result.Ticks);
+            Lock.lock();
+
+            // viewport jumped or symbol changed while we were reading.
+            // failures go back too so the chart thread can take the bar off the prefetch list
+            if (Req.Generation == Generation)
+            {
+                Ready.push_back(std::move(Result));
+            }
+        }
+    }
+
+    // worker thread only, mapping of the chart's intraday file
+    ScidReader Reader;
+    std::string ReaderPath;
+
+    // binary search to the bar's first record, the bar's records are then one contiguous span
+    bool ReadBar(const std::string& Path, const PrefetchRequest& Req, vector<MagicTick>& Ticks)
+    {
+        if (Path != ReaderPath || !Reader.IsOpen())
+        {
+            ReaderPath = Path;
+            if (!Reader.Open(Path))
+            {
+                return(false);
+            }
+        }
+        else
+        {
+            // file keeps growing while the chart is live
+            Reader.Refresh();
+        }
+
+        int64_t FileStart = ScidDateTimeFromDays(Req.FileStart.GetAsDouble());
+        int64_t FileEnd = ScidDateTimeFromDays(Req.FileEnd.GetAsDouble());
+
+        TickSampler Sampler;
+        Sampler.Reset(Req.Budget, Req.LargeThreshold, Req.BarMs, Req.Low, Req.High, Req.TickSize);
+        for (const ScidRecord &Record : Reader.Range(FileStart, FileEnd))
+        {
+            float Price = Record.Close;
+            if (ScidIsSingleTrade(Record) && Price <= Req.High && Price >= Req.Low)
+            {
+                MagicTick Tick;
+                Tick.PriceInTicks = (int)floor(Price / Req.TickSize + 0.5f);
+                Tick.Volume = Record.TotalVolume;
+                Tick.BidVolume = Record.BidVolume;
+                Tick.AskVolume = Record.AskVolume;
+                // file times are UTC, offset from the file time of the bar start
+                Tick.MsOffset = (unsigned int)((Record.DateTime - FileStart) / 1000);
+                Sampler.Add(Tick);
+            }
+        }
+
+        Sampler.GetSample(Ticks);
+        return(true);
+    }
+};
+
+// one glyph on screen, every tick that lands on the same x pixel and price level
+struct RenderCell
+{
+    int x;
+    int PriceInTicks;
+    unsigned int Volume;
+    // ask volume minus bid volume
+    long long NetVolume;
+    // built from a per price or summary tier rather than individual ticks
+    bool Aggregate;
+};
+
+// ticks binned into screen cells, only rebuilt when the ticks or the view change
+struct MagicRender
+{
+    vector<RenderCell> Cells;
+
+    // what the cells were built from
+    unsigned int CacheVersion = 0;
+    int ChartBarSpacing = -1;
+    int FirstIdx = -1;
+    int LastIdx = -1;
+    int xFirstBar = 0;
+    float vHigh = 0;
+    float vLow = 0;
+
+    bool IsStale(unsigned int CurrCacheVersion, SCStudyInterfaceRef sc, float CurrHigh, float CurrLow)
+    {
+        return (CacheVersion != CurrCacheVersion
+            || ChartBarSpacing != sc.ChartBarSpacing
+            || FirstIdx != sc.IndexOfFirstVisibleBar
+            || LastIdx != sc.IndexOfLastVisibleBar
+            || xFirstBar != sc.BarIndexToXPixelCoordinate(sc.IndexOfFirstVisibleBar)
+            || vHigh != CurrHigh
+            || vLow != CurrLow);
+    }
+};
+
+// persistent tick cache.
+// closed bars are read once and kept until they scroll out of the retention margin,
+// the live bar is extended from where the last read left off.
+// ticks for every bar share one arena, each bar's ticks are contiguous and oldest first.
+struct MagicCache
+{
+    vector<MagicTick> Arena;
+
+    // ticks in the arena no longer referenced by any bar
+    size_t GarbageTicks = 0;
+
+    // dense per bar table, Slots[0] holds bar FirstCachedIdx
+    int FirstCachedIdx = 0;
+    vector<BarSlot> Slots;
+
+    // bumped whenever cached ticks change
+    unsigned int Version = 0;
+
+    MagicPrefetcher Prefetcher;
+    // first visible bar on the previous update, tells us which way we are scrolling
+    int PrevFirstVisibleIdx = -1;
+
+    MagicTiming UpdateTiming;
+    MagicTiming PaintTiming;
+    MagicTiming LockTiming;
+
+    MagicRender Render;
+
+    // sampler for the bar still being read, usually the live bar
+    TickSampler LiveSampler;
+    int LiveSamplerIdx = -1;
+
+    // closed bar the lock budget ran out on, carried on from here next update
+    TickSampler PartialSampler;
+    int PartialSamplerIdx = -1;
+
+    // what the cached bar indexes refer to, any change invalidates the cache
+    SCString Symbol;
+    n_ACSIL::s_BarPeriod BarPeriod;
+    SCDateTime FirstBarDateTime;
+    int ArraySize = 0;
+
+    // true if the chart's symbol, bar period or loaded intraday data
+    // no longer match what the cached bar indexes were read from
+    bool IsStale(SCStudyInterfaceRef sc, const n_ACSIL::s_BarPeriod& CurrBarPeriod)
+    {
+        return (Symbol != sc.Symbol
+            || BarPeriod.ChartDataType != CurrBarPeriod.ChartDataType
+            || BarPeriod.IntradayChartBarPeriodType != CurrBarPeriod.IntradayChartBarPeriodType
+            || BarPeriod.IntradayChartBarPeriodParameter1 != CurrBarPeriod.IntradayChartBarPeriodParameter1
+            || BarPeriod.IntradayChartBarPeriodParameter2 != CurrBarPeriod.IntradayChartBarPeriodParameter2
+            || sc.ArraySize < ArraySize
+            || (sc.ArraySize > 0 && FirstBarDateTime != sc.BaseDateTimeIn[0]));
+    }
+
+    // throw everything away and remember what the new cache is for
+    void Reset(SCStudyInterfaceRef sc, const n_ACSIL::s_BarPeriod& CurrBarPeriod)
+    {
+        Arena.clear();
+        GarbageTicks = 0;
+        Version++;
+        FirstCachedIdx = 0;
+        Slots.clear();
+        LiveSamplerIdx = -1;
+        PartialSamplerIdx = -1;
+        Prefetcher.Cancel();
+        PrevFirstVisibleIdx = -1;
+        Symbol = sc.Symbol;
+        BarPeriod = CurrBarPeriod;
+        FirstBarDateTime = sc.ArraySize > 0 ? sc.BaseDateTimeIn[0] : SCDateTime();
+        ArraySize = sc.ArraySize;
+    }
+
+    // NULL if the bar is outside the cached range
+    BarSlot* GetSlot(int BarIdx)
+    {
+        int SlotIdx = BarIdx - FirstCachedIdx;
+        if (SlotIdx < 0 || SlotIdx >= (int)Slots.size())
+        {
+            return NULL;
+        }
+        return &Slots[SlotIdx];
+    }
+
+    const MagicTick* GetTicks(const BarSlot& Slot) const
+    {
+        return Arena.data() + Slot.Offset;
+    }
+
+    // cover bars FirstIdx through LastIdx, bars outside that range are dropped
+    void SetWindow(int FirstIdx, int LastIdx)
+    {
+        int NumSlots = max(LastIdx - FirstIdx + 1, 0);
+        if (FirstIdx == FirstCachedIdx && NumSlots == Slots.size())
+        {
+            return;
+        }
+
+        vector<BarSlot> NewSlots(NumSlots);
+        for (int i=0; i<Slots.size(); i++)
+        {
+            int BarIdx = FirstCachedIdx + i;
+            if (BarIdx >= FirstIdx && BarIdx <= LastIdx)
+            {
+                NewSlots[BarIdx - FirstIdx] = std::move(Slots[i]);
+            }
+            else
+            {
+                GarbageTicks += Slots[i].Count;
+            }
+        }
+        Slots.swap(NewSlots);
+        FirstCachedIdx = FirstIdx;
+        Version++;
+
+        // compact once most of the arena is unreferenced
+        if (GarbageTicks > Arena.size() / 2)
+        {
+            Compact();
+        }
+    }
+
+    // make sure new ticks can be appended to this bar
+    void MoveToEnd(BarSlot& Slot)
+    {
+        if (Slot.Count == 0)
+        {
+            Slot.Offset = Arena.size();
+            return;
+        }
+        if (Slot.Offset + Slot.Count == Arena.size())
+        {
+            return;
+        }
+
+        // another bar was read after this one, copy its ticks to the end
+        size_t NewOffset = Arena.size();
+        Arena.resize(NewOffset + Slot.Count);
+        std::copy(Arena.begin() + Slot.Offset, Arena.begin() + Slot.Offset + Slot.Count, Arena.begin() + NewOffset);
+        GarbageTicks += Slot.Count;
+        Slot.Offset = NewOffset;
+    }
+
+    // rebuild the arena in bar order without unreferenced ticks
+    void Compact()
+    {
+        vector<MagicTick> NewArena;
+        NewArena.reserve(Arena.size() - GarbageTicks);
+        for (BarSlot& Slot : Slots)
+        {
+            size_t NewOffset = NewArena.size();
+            NewArena.insert(NewArena.end(), Arena.begin() + Slot.Offset, Arena.begin() + Slot.Offset + Slot.Count);
+            Slot.Offset = NewOffset;
+        }
+        Arena.swap(NewArena);
+        GarbageTicks = 0;
+    }
+
+    // replace the bar's ticks and lay them out over SpanMs, see LayoutTicks()
+    void Store(BarSlot& Slot, const vector<MagicTick>& Ticks, long long SpanMs)
+    {
+        MoveToEnd(Slot);
+        Arena.resize(Slot.Offset);
+        Arena.insert(Arena.end(), Ticks.begin(), Ticks.end());
+        Slot.Count = Ticks.size();
+        LayoutTicks(Arena.data() + Slot.Offset, Slot.Count, SpanMs);
+        Slot.Lod = BarLod();
+        Version++;
+    }
+
+    // subset, per price and summary tiers for a bar, built on first use
+    const BarLod& GetLod(BarSlot& Slot, unsigned int LargeThreshold)
+    {
+        BarLod &Lod = Slot.Lod;
+        if (Lod.Built)
+        {
+            return(Lod);
+        }
+
+        const MagicTick *Ticks = GetTicks(Slot);
+        unordered_map<int, int> LevelIndex;
+        long long PriceVolume = 0;
+        int NumRegular = 0;
+        for (unsigned int i=0; i<Slot.Count; i++)
+        {
+            const MagicTick &Tick = Ticks[i];
+            long long NetVolume = (long long)Tick.AskVolume - Tick.BidVolume;
+
+            if (Tick.Volume >= LargeThreshold || NumRegular++ % LOD_SUBSET_RATIO == 0)
+            {
+                Lod.Subset.push_back(Tick);
+            }
+
+            auto Found = LevelIndex.find(Tick.PriceInTicks);
+            if (Found == LevelIndex.end())
+            {
+                LevelIndex[Tick.PriceInTicks] = Lod.Levels.size();
+                PriceAggregate Level = { Tick.PriceInTicks, 0, 0 };
+                Lod.Levels.push_back(Level);
+                Found = LevelIndex.find(Tick.PriceInTicks);
+            }
+            PriceAggregate &Level = Lod.Levels[Found->second];
+            Level.Volume += Tick.Volume;
+            Level.NetVolume += NetVolume;
+
+            Lod.Summary.Volume += Tick.Volume;
+            Lod.Summary.NetVolume += NetVolume;
+            PriceVolume += (long long)Tick.PriceInTicks * Tick.Volume;
+        }
+
+        if (Lod.Summary.Volume > 0)
+        {
+            Lod.Summary.PriceInTicks = (int)floor((double)PriceVolume / Lod.Summary.Volume + 0.5);
+        }
+        else if (Slot.Count > 0)
+        {
+            Lod.Summary.PriceInTicks = Ticks[Slot.Count-1].PriceInTicks;
+        }
+        Lod.Built = true;
+        return(Lod);
+    }
+};
+
+// time span of a closed bar in ms, 0 for the live bar which is stretched to its newest tick
+long long GetBarSpanMs(SCStudyInterfaceRef sc, int BarIdx)
+{
+    if (BarIdx >= sc.ArraySize-1)
+    {
+        return(0);
+    }
+    return GetMsBetween(sc.BaseDateTimeIn[BarIdx], sc.BaseDateTimeIn[BarIdx+1]);
+}
+
+// x pixel range the ticks of a bar are spread over
+void GetMagicBarExtent(SCStudyInterfaceRef sc, int BarIdx, float MagicWidthPerc, int& xBarStart, int& xBarEnd)
+{
+    // x coord position
+    xBarStart = sc.BarIndexToXPixelCoordinate(BarIdx) - 2;
+
+    // next bar's start
+    int xNextBarStart = sc.BarIndexToXPixelCoordinate(BarIdx+1)-1;
+
+    // adjustable bar width
+    //float MagicBarWidth = 0.90; // very defined
+    //float MagicBarWidth = 1.50;  // together seamlessly
+    int xBarWidth = (xNextBarStart - xBarStart) * MagicWidthPerc;
+
+    // adjust bar start based on dynamic width
+    xBarStart -= xBarWidth/3;
+    xBarEnd = xBarStart + xBarWidth - (xBarWidth/3);
+}
+
+// render pre-pass, bin the visible ticks into (x pixel, price level) cells.
+// each bar draws from the level of detail tier that fits the pixels it gets.
+void BuildRenderCells(SCStudyInterfaceRef sc, MagicCache& Cache, float MagicWidthPerc, float vHigh, float vLow, unsigned int LargeThreshold, int BarsBeforeSummary)
+{
+    MagicRender &Render = Cache.Render;
+    Render.Cells.clear();
+
+    // (x << 32 | price in ticks) => index into Cells
+    unordered_map<unsigned long long, int> CellIndex;
+    auto AddToCell = [&](int x, int PriceInTicks, unsigned int Volume, long long NetVolume, bool Aggregate)
+    {
+        unsigned long long Key = ((unsigned long long)(unsigned int)x << 32) | (unsigned int)PriceInTicks;
+        auto Found = CellIndex.find(Key);
+        if (Found == CellIndex.end())
+        {
+            CellIndex[Key] = Render.Cells.size();
+            RenderCell Cell = { x, PriceInTicks, 0, 0, Aggregate };
+            Render.Cells.push_back(Cell);
+            Found = CellIndex.find(Key);
+        }
+        RenderCell &Cell = Render.Cells[Found->second];
+        Cell.Volume += Volume;
+        Cell.NetVolume += NetVolume;
+    };
+
+    // too many bars on screen, everything gets the summary glyph
+    bool SummaryOnly = sc.IndexOfLastVisibleBar - sc.IndexOfFirstVisibleBar > BarsBeforeSummary;
+
+    for (int CurrIdx=sc.IndexOfFirstVisibleBar; CurrIdx<=sc.IndexOfLastVisibleBar; CurrIdx++)
+    {
+        BarSlot *p_Bar = Cache.GetSlot(CurrIdx);
+        if (p_Bar == NULL || p_Bar->Count == 0)
+        {
+            continue;
+        }
+
+        int xBarStart, xBarEnd;
+        GetMagicBarExtent(sc, CurrIdx, MagicWidthPerc, xBarStart, xBarEnd);
+        int xDiff = xBarEnd - xBarStart;
+        int xCenter = xBarStart + xDiff/2;
+
+        // pick the tier from the bar's width on screen
+        int PixelsPerBar = sc.BarIndexToXPixelCoordinate(CurrIdx+1) - sc.BarIndexToXPixelCoordinate(CurrIdx);
+        MagicLodTier Tier = LOD_SUMMARY;
+        if (SummaryOnly)
+        {
+            Tier = LOD_SUMMARY;
+        }
+        else if (PixelsPerBar >= LOD_FULL_MIN_PIXELS)
+        {
+            Tier = LOD_FULL;
+        }
+        else if (PixelsPerBar >= LOD_SUBSET_MIN_PIXELS)
+        {
+            Tier = LOD_SUBSET;
+        }
+        else if (PixelsPerBar >= LOD_LEVELS_MIN_PIXELS)
+        {
+            Tier = LOD_LEVELS;
+        }
+
+        if (Tier == LOD_FULL || Tier == LOD_SUBSET)
+        {
+            const MagicTick *Ticks = Cache.GetTicks(*p_Bar);
+            int TicksForBarIdx = p_Bar->Count;
+            if (Tier == LOD_SUBSET)
+            {
+                const BarLod &Lod = Cache.GetLod(*p_Bar, LargeThreshold);
+                Ticks = Lod.Subset.data();
+                TicksForBarIdx = Lod.Subset.size();
+            }
+
+            // ticks were laid out by time when they were cached, only scale to the bar's width here
+            for (int i=0; i<TicksForBarIdx; i++)
+            {
+                const MagicTick &Tick = Ticks[i];
+                int xTarget = xBarStart + ((xDiff * Tick.XFraction) >> 16);
+                AddToCell(xTarget, Tick.PriceInTicks, Tick.Volume, (long long)Tick.AskVolume - Tick.BidVolume, false);
+            }
+        }
+        else if (Tier == LOD_LEVELS)
+        {
+            for (const PriceAggregate &Level : Cache.GetLod(*p_Bar, LargeThreshold).Levels)
+            {
+                AddToCell(xCenter, Level.PriceInTicks, Level.Volume, Level.NetVolume, true);
+            }
+        }
+        else
+        {
+            const PriceAggregate &Summary = Cache.GetLod(*p_Bar, LargeThreshold).Summary;
+            AddToCell(xCenter, Summary.PriceInTicks, Summary.Volume, Summary.NetVolume, true);
+        }
+    }
+
+    Render.CacheVersion = Cache.Version;
+    Render.ChartBarSpacing = sc.ChartBarSpacing;
+    Render.FirstIdx = sc.IndexOfFirstVisibleBar;
+    Render.LastIdx = sc.IndexOfLastVisibleBar;
+    Render.xFirstBar = sc.BarIndexToXPixelCoordinate(sc.IndexOfFirstVisibleBar);
+    Render.vHigh = vHigh;
+    Render.vLow = vLow;
+}
+
 SCSFExport scsf_Magic(SCStudyInterfaceRef sc)
 {
     // logging object
@@ -30,6 +924,10 @@ SCSFExport scsf_Magic(SCStudyInterfaceRef sc)
     SCInputRef i_BidColor = sc.Input[++InputIdx];
     SCInputRef i_AskColor = sc.Input[++InputIdx];
     SCInputRef i_EnablePositionDebug = sc.Input[++InputIdx];
+    SCInputRef i_CacheMarginBars = sc.Input[++InputIdx];
+    SCInputRef i_PrefetchBars = sc.Input[++InputIdx];
+    SCInputRef i_LogTiming = sc.Input[++InputIdx];
+    SCInputRef i_LockBudgetMs = sc.Input[++InputIdx];
 
     // Set configuration variables
     if (sc.SetDefaults)
@@ -41,13 +939,13 @@ SCSFExport scsf_Magic(SCStudyInterfaceRef sc)
         i_UpdateIntervalMs.Name = "Update Interval in Milliseconds";
         i_UpdateIntervalMs.SetInt(250);
 
-        i_MaxTicksPerBar.Name = "Max ticks drawn per bar (0=off)";
+        i_MaxTicksPerBar.Name = "Max ticks drawn per bar, large executions always drawn (0=off)";
         i_MaxTicksPerBar.SetInt(3000);
 
-        i_SizeDownThreshold.Name = "Start Skipping Records After This #";
+        i_SizeDownThreshold.Name = "Start Skipping Records After This # (unused)";
         i_SizeDownThreshold.SetInt(10);
 
-        i_SkipRate.Name = "% Skip Rate";
+        i_SkipRate.Name = "% Skip Rate (unused)";
         i_SkipRate.SetFloat(0.01);
 
         i_FontSize.Name = "Font Size";
@@ -68,8 +966,8 @@ SCSFExport scsf_Magic(SCStudyInterfaceRef sc)
         i_LargeExecutionStr.Name = "Character to print for large executions, i.e. 'O'";
         i_LargeExecutionStr.SetString("O");
 
-        i_BarsBeforeTurningOff.Name = "Stop displaying executions after this many bars are on screen.";
-        i_BarsBeforeTurningOff.SetInt(11);
+        i_BarsBeforeTurningOff.Name = "Only draw one summary glyph per bar after this many bars are on screen.";
+        i_BarsBeforeTurningOff.SetInt(40);
 
         i_BidColor.Name = "Bid Color";
         i_BidColor.SetColor(COLOR_RED);
@@ -80,12 +978,43 @@ SCSFExport scsf_Magic(SCStudyInterfaceRef sc)
         i_EnablePositionDebug.Name = "Enable Position Debug on Bars";
         i_EnablePositionDebug.SetYesNo(0);
 
+        i_CacheMarginBars.Name = "Keep cached ticks for this many bars off screen";
+        i_CacheMarginBars.SetInt(50);
+        i_CacheMarginBars.SetIntLimits(0, 10000);
+
+        i_PrefetchBars.Name = "Prefetch this many bars ahead of scrolling in the background (0=off)";
+        i_PrefetchBars.SetInt(20);
+        i_PrefetchBars.SetIntLimits(0, 1000);
+
+        i_LogTiming.Name = "Log update, paint and intraday file lock timing";
+        i_LogTiming.SetYesNo(0);
+
+        i_LockBudgetMs.Name = "Max ms to hold the intraday file lock per update, the rest is read on the next one";
+        i_LockBudgetMs.SetInt(20);
+        i_LockBudgetMs.SetIntLimits(1, 1000);
+
         //this must be set to 1 in order to use the sc.ReadIntradayFileRecordForBarIndexAndSubIndex function. 
         // https://dtcprotocol.org/SupportBoard.php?PostID=130661#P130661
         sc.MaintainAdditionalChartDataArrays = 1;
         return;
     }
 
+    // persistent structure holding tick data for each bar
+    MagicCache *p_Cache = (MagicCache*)sc.GetPersistentPointer(0);
+    if (p_Cache == NULL)
+    {
+        p_Cache = new MagicCache;
+        sc.SetPersistentPointer(0, p_Cache);
+    }
+
+    // cleanup, also stops the prefetch worker
+    if (sc.LastCallToFunction)
+    {
+        delete p_Cache;
+        sc.SetPersistentPointer(0, NULL);
+        return;
+    }
+
     // delay interval logic
     int &LastUpdated = sc.GetPersistentInt(0);
     int Interval = i_UpdateIntervalMs.GetInt();
@@ -112,100 +1041,265 @@ SCSFExport scsf_Magic(SCStudyInterfaceRef sc)
         return;
     }
 
-    // persistent structure holding tick data for each bar
-    unordered_map<int, vector<s_IntradayRecord>> *p_TicksPerBar = (unordered_map<int, vector<s_IntradayRecord>>*)sc.GetPersistentPointer(0);
-    if (p_TicksPerBar == NULL)
+    // symbol, bar period or intraday file changed, bar indexes no longer line up with the cache
+    n_ACSIL::s_BarPeriod BarPeriod;
+    sc.GetBarPeriodParameters(BarPeriod);
+    if (sc.IsFullRecalculation || p_Cache->IsStale(sc, BarPeriod))
     {
-        p_TicksPerBar = new unordered_map<int, vector<s_IntradayRecord>>;
-        sc.SetPersistentPointer(0, p_TicksPerBar);
+        p_Cache->Reset(sc, BarPeriod);
     }
+    p_Cache->ArraySize = sc.ArraySize;
 
     if (sc.Index == 0 || UpdateTicks)
     {
+        auto UpdateStart = std::chrono::steady_clock::now();
 
         //msg.Format("Update=%d, MaxTicks=%d, FontSize=%d", Interval, i_MaxTicksPerBar.GetInt(), i_FontSize.GetInt());
         //sc.AddMessageToLog(msg, 0);
 
-        // reset
-        p_TicksPerBar->clear();
-
         const int MAX_SIZE = i_MaxTicksPerBar.GetInt();
-        const int SIZE_DOWN_SAMPLING_THRESHOLD = i_SizeDownThreshold.GetInt();
-        const float SKIP_RATE = i_SkipRate.GetFloat();
+        const int LARGE_EXECUTION_THRESHOLD = i_LargeExecutionThreshold.GetInt();
+
+        // sampler for closed bars read in one go
+        TickSampler Sampler;
+        vector<MagicTick> Sample;
+
+        // forget bars that scrolled well out of view
+        int CacheMarginBars = i_CacheMarginBars.GetInt();
+        p_Cache->SetWindow(max(sc.IndexOfFirstVisibleBar - CacheMarginBars, 0), min(sc.IndexOfLastVisibleBar + CacheMarginBars, sc.ArraySize-1));
+
+        // pick up bars the prefetch worker finished.
+        // continuous futures charts read older bars from other contracts' files, which the
+        // worker doesn't know about, so those are only ever read on the chart thread
+        bool PrefetchEnabled = sc.ContinuousFuturesContractOption == 0;
+        std::string FilePath = sc.DataFilesFolder().GetChars();
+        if (!FilePath.empty() && FilePath.back() != '\\' && FilePath.back() != '/')
+        {
+            FilePath += "\\";
+        }
+        FilePath += sc.Symbol.GetChars();
+        FilePath += ".scid";
+        p_Cache->Prefetcher.SetFile(FilePath);
+
+        unsigned int Generation = p_Cache->Prefetcher.GetGeneration();
+        vector<PrefetchResult> Results;
+        p_Cache->Prefetcher.TakeReady(Results);
+        for (PrefetchResult &Result : Results)
+        {
+            BarSlot *p_Bar = p_Cache->GetSlot(Result.BarIdx);
+            if (Result.Generation != Generation || p_Bar == NULL || p_Bar->Complete)
+            {
+                continue;
+            }
+            p_Bar->Prefetching = false;
+
+            // a bar that traded but came back empty isn't in this file (or the read failed),
+            // leave it for ReadIntradayFileRecordForBarIndexAndSubIndex
+            if (!Result.Success || (Result.Ticks.empty() && sc.Volume[Result.BarIdx] > 0))
+            {
+                continue;
+            }
+            p_Cache->Store(*p_Bar, Result.Ticks, GetBarSpanMs(sc, Result.BarIdx));
+            p_Bar->Complete = true;
+        }
+
+        // the intraday file is locked once for the visible range, not once per bar, but only for
+        // LOCK_BUDGET_MS. whatever is left is read on the next update so Sierra can keep writing
+        const int LOCK_BUDGET_MS = i_LockBudgetMs.GetInt();
+        bool LockHeld = false;
+        bool OutOfTime = false;
+        std::chrono::steady_clock::time_point LockStart;
+        int NumRecordsRead = 0;
+        s_IntradayRecord IntradayRecord;
 
         // visible bars only
         for (int CurrIdx=sc.IndexOfFirstVisibleBar; CurrIdx<=sc.IndexOfLastVisibleBar; CurrIdx++)
         {
+            BarSlot *p_Bar = p_Cache->GetSlot(CurrIdx);
+            if (p_Bar == NULL)
+            {
+                continue;
+            }
+            BarSlot &Bar = *p_Bar;
+
+            // closed bars already read in full
+            if (Bar.Complete)
+            {
+                continue;
+            }
+
+            // closed bars are sampled in a single pass, the live bar keeps its sampler between updates
+            bool IsLiveBar = CurrIdx == sc.ArraySize-1;
+            TickSampler *p_Sampler = &Sampler;
+            if (!IsLiveBar && Bar.NextSubIndex > 0 && p_Cache->PartialSamplerIdx == CurrIdx)
+            {
+                // the lock budget ran out part way through this bar last update
+                p_Sampler = &p_Cache->PartialSampler;
+            }
+            else if (IsLiveBar || Bar.NextSubIndex > 0)
+            {
+                p_Sampler = &p_Cache->LiveSampler;
+                if (p_Cache->LiveSamplerIdx != CurrIdx)
+                {
+                    // sampler was for another bar, start this one over
+                    p_Cache->LiveSamplerIdx = CurrIdx;
+                    Bar.NextSubIndex = 0;
+                }
+            }
+            if (Bar.NextSubIndex == 0)
+            {
+                // closed bars span to the next bar, the live bar is assumed to be as long as the previous one
+                long long BarMs = 60000;
+                if (!IsLiveBar)
+                {
+                    BarMs = GetBarSpanMs(sc, CurrIdx);
+                }
+                else if (CurrIdx > 0)
+                {
+                    BarMs = GetMsBetween(sc.BaseDateTimeIn[CurrIdx-1], sc.BaseDateTimeIn[CurrIdx]);
+                }
+                p_Sampler->Reset(MAX_SIZE, LARGE_EXECUTION_THRESHOLD, BarMs, sc.Low[CurrIdx], sc.High[CurrIdx], sc.TickSize);
+            }
 
             // Intraday Record File reading
             int ReadSuccess = true;
-            bool FirstIteration = true;
-            s_IntradayRecord IntradayRecord;
-            int SubIndex = 0;//Start at first record within bar
+            int SubIndex = Bar.NextSubIndex;//Continue from the last record read within bar
 
             //Read records until sc.ReadIntradayFileRecordForBarIndexAndSubIndex returns 0
             while (ReadSuccess)
             {
+                // held the lock long enough, checked every so often since the clock isn't free
+                if (NumRecordsRead > 0 && NumRecordsRead % 256 == 0
+                    && std::chrono::steady_clock::now() - LockStart >= std::chrono::milliseconds(LOCK_BUDGET_MS))
+                {
+                    OutOfTime = true;
+                    break;
+                }
 
                 // default status for our file lock is to do nothing
                 IntradayFileLockActionEnum  IntradayFileLockAction = IFLA_NO_CHANGE;
-                if (FirstIteration)
+                if (!LockHeld)
                 {
-                    // on first iteration, place lock on intraday file
+                    // first read of this update, place lock on intraday file
                     IntradayFileLockAction = IFLA_LOCK_READ_HOLD;
-                    // flip first iteration semaphore
-                    FirstIteration = false;
+                    LockHeld = true;
+                    LockStart = std::chrono::steady_clock::now();
                 }
 
                 // read intraday records at these indicies
                 ReadSuccess = sc.ReadIntradayFileRecordForBarIndexAndSubIndex(CurrIdx, SubIndex, IntradayRecord, IntradayFileLockAction);
 
-                if (ReadSuccess)
+                if (!ReadSuccess)
+                {
+                    // end of the bar's records, pick up from here next time
+                    break;
+                }
+                ++NumRecordsRead;
+
+                if (IntradayRecord.IsSingleTradeWithBidAsk())
                 {
-                    if (IntradayRecord.IsSingleTradeWithBidAsk())
+                    // fetch properties of this trade
+                    float Price = IntradayRecord.GetClose();
+                    // if its within the bounds of the bar's prices (no late prints)
+                    if (Price <= sc.High[CurrIdx] && Price >= sc.Low[CurrIdx])
                     {
-                        // fetch properties of this trade
-                        int Volume = IntradayRecord.TotalVolume;
-                        float Price = IntradayRecord.GetClose();
-                        // if its within the bounds of the bar's prices (no late prints)
-                        if (Price <= sc.High[CurrIdx] && Price >= sc.Low[CurrIdx])
-                        {
-                            int Year = IntradayRecord.DateTime.GetYear();
-                            int Month = IntradayRecord.DateTime.GetMonth();
-                            int Day = IntradayRecord.DateTime.GetDay();
-                            int Hour = IntradayRecord.DateTime.GetHour();
-                            int Minute = IntradayRecord.DateTime.GetMinute();
-                            int Second = IntradayRecord.DateTime.GetSecond();
-                            // store into persisting struct
-                            (*p_TicksPerBar)[CurrIdx].push_back(IntradayRecord);
-                            //msg.Format("Storing @ Index %d: [%d/%d][%d:%d:%d] %d @ %f", CurrIdx, SubIndex, p_TicksPerBar[CurrIdx].size(), Hour, Minute, Second, Volume, Price);
-                            //sc.AddMessageToLog(msg, 0);
-                        }
+                        // down sampling keeps every large print and spreads the rest over time and price
+                        p_Sampler->Add(MakeTick(IntradayRecord, sc.BaseDateTimeIn[CurrIdx], sc.TickSize));
                     }
                 }
                 ++SubIndex;
+            } // end of intraday file reading loop
 
-                // down sampling logic for performance optimization
-                // start skipping records if we hit our threshold
-                if ((*p_TicksPerBar)[CurrIdx].size() > SIZE_DOWN_SAMPLING_THRESHOLD)
+            // store into persisting struct
+            p_Sampler->GetSample(Sample);
+            p_Cache->Store(Bar, Sample, GetBarSpanMs(sc, CurrIdx));
+
+            // remember where we stopped, the live bar continues from here on the next update
+            Bar.NextSubIndex = SubIndex;
+
+            // out of lock time, the rest of this bar and the ones after it wait for the next update
+            if (OutOfTime)
+            {
+                if (p_Sampler == &Sampler)
                 {
-                    SubIndex += max(SKIP_RATE * (*p_TicksPerBar)[CurrIdx].size(), 1);
+                    std::swap(p_Cache->PartialSampler, Sampler);
+                    p_Cache->PartialSamplerIdx = CurrIdx;
                 }
+                break;
+            }
 
-                // stop storing records after this point
-                if (MAX_SIZE > 0 && (*p_TicksPerBar)[CurrIdx].size() > MAX_SIZE)
+            // a closed bar can't get any new ticks
+            if (CurrIdx < sc.ArraySize-1)
+            {
+                Bar.Complete = true;
+            }
+        }
+
+        // done reading the range, release lock
+        if (LockHeld)
+        {
+            sc.ReadIntradayFileRecordForBarIndexAndSubIndex(-1, -1, IntradayRecord, IFLA_RELEASE_AFTER_READ);
+            if (i_LogTiming.GetYesNo())
+            {
+                p_Cache->LockTiming.Add(sc, "intraday file lock held", LockStart, NumRecordsRead);
+            }
+        }
+
+        // queue up bars past the edge we are scrolling towards
+        const int PREFETCH_BARS = PrefetchEnabled ? min(i_PrefetchBars.GetInt(), CacheMarginBars) : 0;
+        int NumVisibleBars = sc.IndexOfLastVisibleBar - sc.IndexOfFirstVisibleBar + 1;
+        int ScrolledBy = sc.IndexOfFirstVisibleBar - p_Cache->PrevFirstVisibleIdx;
+        if (p_Cache->PrevFirstVisibleIdx >= 0 && abs(ScrolledBy) > NumVisibleBars)
+        {
+            // viewport jumped, whatever was queued is no longer next to it
+            p_Cache->Prefetcher.Cancel();
+            Generation = p_Cache->Prefetcher.GetGeneration();
+            for (BarSlot &Slot : p_Cache->Slots)
+            {
+                Slot.Prefetching = false;
+            }
+        }
+        else if (PREFETCH_BARS > 0 && ScrolledBy != 0 && p_Cache->PrevFirstVisibleIdx >= 0)
+        {
+            int Direction = ScrolledBy < 0 ? -1 : 1;
+            int EdgeIdx = Direction < 0 ? sc.IndexOfFirstVisibleBar : sc.IndexOfLastVisibleBar;
+            for (int n=1; n<=PREFETCH_BARS; n++)
+            {
+                // the live bar is never prefetched, it is still changing
+                int BarIdx = EdgeIdx + n * Direction;
+                BarSlot *p_Bar = p_Cache->GetSlot(BarIdx);
+                if (p_Bar == NULL || BarIdx >= sc.ArraySize-1 || p_Bar->Complete || p_Bar->Prefetching)
                 {
-                    //msg.Format("Bailing out due to max size hit");
-                    //sc.AddMessageToLog(msg, 0);
-                    break;
+                    continue;
                 }
-            } // end of intraday file reading loop
 
-            // done reading, release lock
-            sc.ReadIntradayFileRecordForBarIndexAndSubIndex(-1, -1, IntradayRecord, IFLA_RELEASE_AFTER_READ);
+                PrefetchRequest Req;
+                Req.BarIdx = BarIdx;
+                Req.Generation = Generation;
+                Req.FileStart = sc.BaseDateTimeIn[BarIdx] - sc.TimeScaleAdjustment;
+                Req.FileEnd = sc.BaseDateTimeIn[BarIdx+1] - sc.TimeScaleAdjustment;
+                Req.BarMs = GetBarSpanMs(sc, BarIdx);
+                Req.High = sc.High[BarIdx];
+                Req.Low = sc.Low[BarIdx];
+                Req.TickSize = sc.TickSize;
+                Req.Budget = MAX_SIZE;
+                Req.LargeThreshold = LARGE_EXECUTION_THRESHOLD;
+                p_Bar->Prefetching = true;
+                int DroppedBarIdx = p_Cache->Prefetcher.Request(Req);
 
-            // reverse sort this index - needed for drawing (TODO)
-            std::reverse((*p_TicksPerBar)[CurrIdx].begin(), (*p_TicksPerBar)[CurrIdx].end());
+                // a dropped request would otherwise leave its bar marked as on the way forever
+                BarSlot *p_Dropped = DroppedBarIdx >= 0 ? p_Cache->GetSlot(DroppedBarIdx) : NULL;
+                if (p_Dropped != NULL)
+                {
+                    p_Dropped->Prefetching = false;
+                }
+            }
+        }
+        p_Cache->PrevFirstVisibleIdx = sc.IndexOfFirstVisibleBar;
+
+        if (i_LogTiming.GetYesNo())
+        {
+            p_Cache->UpdateTiming.Add(sc, "update", UpdateStart);
         }
     }
 
@@ -216,16 +1310,15 @@ SCSFExport scsf_Magic(SCStudyInterfaceRef sc)
 void DrawToChart(HWND WindowHandle, HDC DeviceContext, SCStudyInterfaceRef sc)
 {
     SCString msg, log;
+    auto PaintStart = std::chrono::steady_clock::now();
 
     int FirstIdx = sc.IndexOfFirstVisibleBar;
     int LastIdx = sc.IndexOfLastVisibleBar;
 
     // find our struct we built from reading intraday file
-    unordered_map<int, vector<s_IntradayRecord>> *p_TicksPerBar = (unordered_map<int, vector<s_IntradayRecord>>*)sc.GetPersistentPointer(0);
-    if (p_TicksPerBar == NULL)
+    MagicCache *p_Cache = (MagicCache*)sc.GetPersistentPointer(0);
+    if (p_Cache == NULL)
     {
-        p_TicksPerBar = new unordered_map<int, vector<s_IntradayRecord>>;
-        sc.SetPersistentPointer(0, p_TicksPerBar);
         return;
     }
 
@@ -236,17 +1329,11 @@ void DrawToChart(HWND WindowHandle, HDC DeviceContext, SCStudyInterfaceRef sc)
     int LargeExecThreshold       = sc.Input[7].GetInt();
     SCString RegularExecutionStr = sc.Input[8].GetString();
     SCString LargeExecutionStr   = sc.Input[9].GetString();
-    int BarsBeforeTurningOff     = sc.Input[10].GetColor();
+    int BarsBeforeSummary        = sc.Input[10].GetInt();
     COLORREF BidColor       = sc.Input[11].GetColor();
     COLORREF AskColor       = sc.Input[12].GetColor();
     bool EnablePositioningDebug  = sc.Input[13].GetYesNo();
-
-    // safeguard, dont try to render if there's a lot of bars visible
-    if (sc.IndexOfLastVisibleBar - sc.IndexOfFirstVisibleBar > BarsBeforeTurningOff) {
-        //msg.Format("Exiting, too many bars");
-        //sc.AddMessageToLog(msg, 0);
-        return;
-    }
+    bool LogTiming               = sc.Input[16].GetYesNo();
 
     // grab the name of the font used in this chartbook
     SCString chartFont = sc.ChartTextFont();
@@ -278,107 +1365,84 @@ void DrawToChart(HWND WindowHandle, HDC DeviceContext, SCStudyInterfaceRef sc)
     SelectObject(DeviceContext, hFont);
     ::SetTextAlign(DeviceContext, TA_NOUPDATECP);
 
-    for (int CurrIdx=FirstIdx; CurrIdx<=LastIdx; CurrIdx++)
+    // rebuild the cells only when the ticks, bar spacing or visible price range changed
+    if (p_Cache->Render.IsStale(p_Cache->Version, sc, vHigh, vLow))
     {
-        // dont try to paint anything if no trades
-        if ((*p_TicksPerBar)[CurrIdx].size() > 0)
-        {
-
-            // start and end datetimes for this bar
-            SCDateTime BarStart = (*p_TicksPerBar)[CurrIdx].at(0).DateTime;
-            SCDateTime BarEnd = (*p_TicksPerBar)[CurrIdx].at((*p_TicksPerBar)[CurrIdx].size()-1).DateTime;
-
-            // x coord position
-            int xBarStart = sc.BarIndexToXPixelCoordinate(CurrIdx) - 2;
-
-            // store a copy, we'll need it later
-            int xOrigStart = xBarStart;
-
-            // next bar's start
-            int xNextBarStart = sc.BarIndexToXPixelCoordinate(CurrIdx+1)-1;
-
-            // adjustable bar width
-            //float MagicBarWidth = 0.90; // very defined
-            //float MagicBarWidth = 1.50;  // together seamlessly
-            int xBarWidth = (xNextBarStart - xBarStart) * MagicWidthPerc;
-
-            // adjust bar start based on dynamic width
-            xBarStart -= xBarWidth/3;
-            int xBarEnd = xBarStart + xBarWidth - (xBarWidth/3);
-
-            // find the diff
-            int xDiff = xBarEnd - xBarStart;
+        BuildRenderCells(sc, *p_Cache, MagicWidthPerc, vHigh, vLow, LargeExecThreshold, BarsBeforeSummary);
+    }
 
-            // loop through ticks that executed during this bar
-            int TicksForBarIdx = (*p_TicksPerBar)[CurrIdx].size();
-            for (int i=0; i<TicksForBarIdx; i++)
-            {
-                // grab next tick
-                s_IntradayRecord IntradayRecord = (*p_TicksPerBar)[CurrIdx].at(i);
+    // one glyph per cell, paint cost scales with screen area rather than tick count or zoom
+    for (const RenderCell &Cell : p_Cache->Render.Cells)
+    {
+        // set colors as needed
+        log.Format("%s", RegularExecutionStr.GetChars());
+        if (Cell.NetVolume < 0)
+        {
+            ::SetTextColor(DeviceContext, BidColor);
+        }
+        else if (Cell.NetVolume > 0)
+        {
+            ::SetTextColor(DeviceContext, AskColor);
+        }
 
-                // extract relevant data from tick record
-                int Volume = IntradayRecord.TotalVolume;
-                int BidVolume = IntradayRecord.BidVolume;
-                int AskVolume = IntradayRecord.AskVolume;
+        // large size special case
+        if (Cell.Volume >= LargeExecThreshold)
+        {
+            log.Format("%s", LargeExecutionStr.GetChars());
+        }
 
-                // set colors as needed
-                log.Format("%s", RegularExecutionStr.GetChars());
-                if (BidVolume > AskVolume)
-                {
-                    ::SetTextColor(DeviceContext, BidColor);
-                }
-                else if (AskVolume > BidVolume)
-                {
-                    ::SetTextColor(DeviceContext, AskColor);
-                }
+        // extra large size special case, aggregates would label every level when zoomed out
+        if (!Cell.Aggregate && Cell.Volume >= 3 * LargeExecThreshold)
+        {
+            // TODO this is equities specific right now
+            log.Format("%s %d", LargeExecutionStr.GetChars(), Cell.Volume/1000);
+        }
 
-                // large size special case
-                if (Volume >= LargeExecThreshold)
-                {
-                    log.Format("%s", LargeExecutionStr.GetChars());
-                }
+        // draw the cell, late prints were already left out of the cache
+        y = sc.RegionValueToYPixelCoordinate(Cell.PriceInTicks * sc.TickSize, sc.GraphRegion);
+        y += yOffset;
+        ::TextOut(DeviceContext, Cell.x, y, log, log.GetLength());
+    }
 
-                // extra large size special case
-                if (Volume >= 3 * LargeExecThreshold)
-                {
-                    // TODO this is equities specific right now
-                    log.Format("%s %d", LargeExecutionStr.GetChars(), Volume/1000);
-                }
+    for (int CurrIdx=FirstIdx; CurrIdx<=LastIdx; CurrIdx++)
+    {
+        const BarSlot *p_Bar = p_Cache->GetSlot(CurrIdx);
+        if (p_Bar == NULL)
+        {
+            continue;
+        }
 
-                // draw the tick
-                if (IntradayRecord.GetClose() <= sc.High[CurrIdx] && IntradayRecord.GetClose() >= sc.Low[CurrIdx])
-                {
-                    float OffsetPercInMs = ((float)i / (float)TicksForBarIdx);
-                    int xTarget = xBarStart - (xDiff * OffsetPercInMs) + xDiff;
-                    y = sc.RegionValueToYPixelCoordinate(IntradayRecord.GetClose(), sc.GraphRegion);
-                    y += yOffset;
-                    ::TextOut(DeviceContext, xTarget, y, log, log.GetLength());
-                }
-            }
+        // enable positioning debug
+        if (EnablePositioningDebug && p_Bar->Count > 0)
+        {
+            int xOrigStart = sc.BarIndexToXPixelCoordinate(CurrIdx) - 2;
+            int xBarStart, xBarEnd;
+            GetMagicBarExtent(sc, CurrIdx, MagicWidthPerc, xBarStart, xBarEnd);
 
-            // enable positioning debug
-            if (EnablePositioningDebug)
-            {
-                // render center pt of candle
-                log.Format("c%d", CurrIdx);
-                ::TextOut(DeviceContext, xOrigStart, y, log, log.GetLength());
-                // render start pt of candle
-                log.Format("s%d", CurrIdx);
-                ::TextOut(DeviceContext, xBarStart, y, log, log.GetLength());
-                // render end pt of candle
-                log.Format("e%d", CurrIdx);
-                ::TextOut(DeviceContext, xBarEnd, y, log, log.GetLength());
-            }
+            // render center pt of candle
+            log.Format("c%d", CurrIdx);
+            ::TextOut(DeviceContext, xOrigStart, y, log, log.GetLength());
+            // render start pt of candle
+            log.Format("s%d", CurrIdx);
+            ::TextOut(DeviceContext, xBarStart, y, log, log.GetLength());
+            // render end pt of candle
+            log.Format("e%d", CurrIdx);
+            ::TextOut(DeviceContext, xBarEnd, y, log, log.GetLength());
         }
 
         // stats
         if (sc.Index == 0)
         {
-            int TmpCurrSize = (*p_TicksPerBar)[CurrIdx].size();
+            int TmpCurrSize = p_Bar->Count;
             msg.Format("[%d] Size=%d", CurrIdx, TmpCurrSize);
             sc.AddMessageToLog(msg, 0);
         }
     }
     // delete font
     DeleteObject(hFont);
+
+    if (LogTiming)
+    {
+        p_Cache->PaintTiming.Add(sc, "paint", PaintStart);
+    }
 }
@@ -1,4 +1,10 @@
 #include "sierrachart.h"
+#include <vector>
+#include <cstring>
+#include "depth_heatmap.h"
+#include "depth_kernel.h"
+#include "liquidity_walls.h"
+#include "number_format.h"
 
 SCDLLName("Frozen Tundra - Market Depth Sizes")
 
@@ -7,6 +13,136 @@ SCDLLName("Frozen Tundra - Market Depth Sizes")
 */
 void DrawToChart(HWND WindowHandle, HDC DeviceContext, SCStudyInterfaceRef sc); 
 
+// don't store more than one heatmap snapshot this often
+const int HEATMAP_MIN_INTERVAL_MS = 250;
+
+// cached heatmap bitmap, only rebuilt on scroll, zoom or new history on screen
+struct HeatmapBitmap {
+    HBITMAP Bitmap = NULL;
+    unsigned int *p_Pixels = NULL;
+    int Left = 0;
+    int Top = 0;
+    int Width = 0;
+    int Height = 0;
+
+    // what the bitmap was built from
+    unsigned int HistoryVersion = 0;
+    int ChartBarSpacing = -1;
+    int FirstIdx = -1;
+    int LastIdx = -1;
+    int xFirstBar = 0;
+    float vHigh = 0;
+    float vLow = 0;
+    int Opacity = -1;
+
+    ~HeatmapBitmap() {
+        if (Bitmap != NULL) {
+            DeleteObject(Bitmap);
+        }
+    }
+
+    // new history only matters when the newest bar is on screen
+    bool IsStale(unsigned int CurrHistoryVersion, SCStudyInterfaceRef sc, float CurrHigh, float CurrLow, int CurrOpacity) {
+        bool live = sc.IndexOfLastVisibleBar >= sc.ArraySize - 1;
+        return (Bitmap == NULL
+            || (live && HistoryVersion != CurrHistoryVersion)
+            || ChartBarSpacing != sc.ChartBarSpacing
+            || FirstIdx != sc.IndexOfFirstVisibleBar
+            || LastIdx != sc.IndexOfLastVisibleBar
+            || xFirstBar != sc.BarIndexToXPixelCoordinate(sc.IndexOfFirstVisibleBar)
+            || vHigh != CurrHigh
+            || vLow != CurrLow
+            || Opacity != CurrOpacity);
+    }
+};
+
+// one side of the book, structure of arrays indexed by depth level
+struct DepthLevels {
+    std::vector<float> Price;
+    std::vector<float> Quantity;
+    std::vector<float> CumQuantity;
+    std::vector<uint8_t> AboveMinimum;
+
+    void Resize(int num_levels) {
+        Price.assign(num_levels, 0);
+        Quantity.assign(num_levels, 0);
+        CumQuantity.assign(num_levels, 0);
+        AboveMinimum.assign(num_levels, 0);
+    }
+
+    // size filter and cumulative size for every level in one pass
+    void Analyse(float minimum_size) {
+        DepthKernelSide side;
+        side.Quantity = Quantity.data();
+        side.CumQuantity = CumQuantity.data();
+        side.AboveMinimum = AboveMinimum.data();
+        side.MinimumSize = minimum_size;
+        DepthKernel(side, (int)Quantity.size());
+    }
+};
+
+// depth captured by the study function, the GDI call only reads it
+struct DepthSnapshot {
+    DepthLevels Bid;
+    DepthLevels Ask;
+    int NumLevels = 0;
+
+    // bumped whenever a level changes, 0 means nothing captured yet
+    unsigned int Version = 0;
+
+    // size filter the AboveMinimum flags were built with
+    int FilterMinimum = -1;
+
+    // large resting orders followed across depth updates
+    LiquidityWallTracker Walls;
+    std::vector<WallLevel> WallLevels;
+    int WallsLatestSequence = 0;
+
+    // T&S copy, reused so a fetch doesn't allocate, and the chart's last bar when it was
+    // fetched. a new execution always moves one of them so depth-only updates skip the fetch.
+    c_SCTimeAndSalesArray TimeSales;
+    int TimeSalesArraySize = -1;
+    float TimeSalesLastVolume = -1;
+
+    // walls are followed when they're logged or filter the labels
+    int TrackWalls = -1;
+
+    // only the walls get labels, not every level over the size filter
+    int ShowOnlyWalls = -1;
+
+    // text for each level, rebuilt by the GDI call only when Version moves
+    std::vector<SCString> BidLabels;
+    std::vector<SCString> AskLabels;
+    unsigned int LabelsVersion = 0;
+    NumberFormatter Numbers;
+
+    // resting size over time for the heatmap
+    DepthHeatmapHistory Heatmap;
+    std::vector<HeatmapLevel> HeatmapLevels;
+    long long HeatmapLastSystemMs = 0;
+    bool HeatmapPending = false;
+    HeatmapBitmap HeatmapCache;
+
+    void Resize(int num_levels) {
+        if (num_levels == NumLevels) {
+            return;
+        }
+        Bid.Resize(num_levels);
+        Ask.Resize(num_levels);
+        BidLabels.assign(num_levels, "");
+        AskLabels.assign(num_levels, "");
+        NumLevels = num_levels;
+        Version = 0;
+        LabelsVersion = 0;
+    }
+};
+
+// chart datetime in milliseconds, heatmap history is keyed by this
+long long GetHeatmapTimeMs(const SCDateTime& DateTime)
+{
+    return (long long)DateTime.GetDate() * 86400000 + DateTime.GetTimeInMilliseconds();
+}
+
 SCSFExport scsf_MarketDepthSizes(SCStudyInterfaceRef sc)
 {
     // number of depth levels to calculate avg lots for
@@ -24,6 +160,27 @@ SCSFExport scsf_MarketDepthSizes(SCStudyInterfaceRef sc)
     // spacing padding to align numbers x axis
     SCInputRef HorizontalOffset = sc.Input[4];
 
+    // liquidity heatmap of resting size over time
+    SCInputRef ShowHeatmap = sc.Input[5];
+
+    // heatmap history is dropped oldest first past this
+    SCInputRef HeatmapMemoryMB = sc.Input[6];
+
+    // heatmap opacity, lets the price bars show through
+    SCInputRef HeatmapOpacity = sc.Input[7];
+
+    // label only the liquidity walls being tracked instead of every level over the minimum size
+    SCInputRef ShowOnlyWalls = sc.Input[8];
+
+    // a level is a wall when it's bigger than this percent of the sizes seen lately
+    SCInputRef WallPercentile = sc.Input[9];
+
+    // how fast older sizes fade out of the wall size distribution
+    SCInputRef WallHalfLifeMinutes = sc.Input[10];
+
+    // write each wall's lifetime, peak size and outcome to the message log when it goes away
+    SCInputRef LogWalls = sc.Input[11];
+
     // logging object
     SCString log_message;
 
@@ -43,31 +200,394 @@ SCSFExport scsf_MarketDepthSizes(SCStudyInterfaceRef sc)
         VerticalOffset.SetInt(20);
         HorizontalOffset.Name = "Horizontal Offset in Pixels";
         HorizontalOffset.SetInt(20);
+        ShowHeatmap.Name = "Show Depth Heatmap";
+        ShowHeatmap.SetYesNo(0);
+        HeatmapMemoryMB.Name = "Depth Heatmap Memory in MB";
+        HeatmapMemoryMB.SetInt(64);
+        HeatmapMemoryMB.SetIntLimits(1, 1024);
+        HeatmapOpacity.Name = "Depth Heatmap Opacity Percent";
+        HeatmapOpacity.SetInt(60);
+        HeatmapOpacity.SetIntLimits(1, 100);
+        ShowOnlyWalls.Name = "Show Only Liquidity Walls";
+        ShowOnlyWalls.SetYesNo(0);
+        WallPercentile.Name = "Liquidity Wall Size Percentile";
+        WallPercentile.SetFloat(98);
+        WallPercentile.SetFloatLimits(50, 99.99f);
+        WallHalfLifeMinutes.Name = "Liquidity Wall Size Half Life in Minutes";
+        WallHalfLifeMinutes.SetInt(5);
+        WallHalfLifeMinutes.SetIntLimits(1, 600);
+        LogWalls.Name = "Log Liquidity Walls";
+        LogWalls.SetYesNo(0);
         return;
     }
 
-    // we need these data to persist to our windows GDI call
+    // depth snapshot persists between calls and is shared with our windows GDI call
+    DepthSnapshot *p_Snapshot = (DepthSnapshot *)sc.GetPersistentPointer(0);
+    if (sc.LastCallToFunction) {
+        delete p_Snapshot;
+        sc.SetPersistentPointer(0, NULL);
+        return;
+    }
+    if (p_Snapshot == NULL) {
+        p_Snapshot = new DepthSnapshot;
+        sc.SetPersistentPointer(0, p_Snapshot);
+    }
+
     int num_levels = NumberOfLevels.GetInt();
-    sc.SetPersistentInt(0, num_levels);
+    p_Snapshot->Resize(num_levels);
+
+    // grab market depth data, we get called on depth updates so this is the only place it's read
+    DepthLevels &bids = p_Snapshot->Bid;
+    DepthLevels &asks = p_Snapshot->Ask;
+    s_MarketDepthEntry bid_mde;
+    s_MarketDepthEntry ask_mde;
+    bool changed = p_Snapshot->Version == 0;
+    for (int i=0; i<num_levels; i++) {
+        sc.GetBidMarketDepthEntryAtLevel(bid_mde, i);
+        sc.GetAskMarketDepthEntryAtLevel(ask_mde, i);
+
+        if (bids.Price[i] != bid_mde.Price || bids.Quantity[i] != (float)bid_mde.Quantity) {
+            bids.Price[i] = bid_mde.Price;
+            bids.Quantity[i] = (float)bid_mde.Quantity;
+            changed = true;
+        }
+        if (asks.Price[i] != ask_mde.Price || asks.Quantity[i] != (float)ask_mde.Quantity) {
+            asks.Price[i] = ask_mde.Price;
+            asks.Quantity[i] = (float)ask_mde.Quantity;
+            changed = true;
+        }
+    }
+
+    // filter changed, or the book moved
+    if (p_Snapshot->FilterMinimum != MinimumSize.GetInt()) {
+        p_Snapshot->FilterMinimum = MinimumSize.GetInt();
+        changed = true;
+    }
+    if (p_Snapshot->ShowOnlyWalls != ShowOnlyWalls.GetYesNo()) {
+        p_Snapshot->ShowOnlyWalls = ShowOnlyWalls.GetYesNo();
+        changed = true;
+    }
+
+    // walls are tracked for the label filter or the log, either one on is enough
+    int track_walls = ShowOnlyWalls.GetYesNo() || LogWalls.GetYesNo();
+    if (p_Snapshot->TrackWalls != track_walls) {
+        p_Snapshot->TrackWalls = track_walls;
+        p_Snapshot->Walls.Clear();
+        changed = true;
+    }
+
+    // liquidity walls, new executions are taken in as they come so they're waiting when the book changes
+    if (track_walls && sc.TickSize > 0) {
+        LiquidityWallTracker &walls = p_Snapshot->Walls;
+        walls.Configure(WallPercentile.GetFloat(), (float)MinimumSize.GetInt(), WallHalfLifeMinutes.GetInt() * 60.0f);
+
+        // NOTE: MAKE SURE TO UPDATE GLOBAL SETTINGS -> NUM TIME AND SALES RECORDS!
+        c_SCTimeAndSalesArray &time_sales = p_Snapshot->TimeSales;
+        int num_records = 0;
+        float last_volume = sc.ArraySize > 0 ? sc.Volume[sc.ArraySize-1] : 0;
+        if (sc.ArraySize != p_Snapshot->TimeSalesArraySize || last_volume != p_Snapshot->TimeSalesLastVolume) {
+            sc.GetTimeAndSales(time_sales);
+            num_records = time_sales.Size();
+            p_Snapshot->TimeSalesArraySize = sc.ArraySize;
+            p_Snapshot->TimeSalesLastVolume = last_volume;
+        }
+        if (num_records > 0) {
+            // tape went backwards (reconnect, replay restart), start over
+            if (time_sales[num_records-1].Sequence < p_Snapshot->WallsLatestSequence) {
+                p_Snapshot->WallsLatestSequence = 0;
+            }
+            int first_new = num_records;
+            while (first_new > 0 && (p_Snapshot->WallsLatestSequence == 0 || time_sales[first_new-1].Sequence > p_Snapshot->WallsLatestSequence)) {
+                first_new--;
+            }
+            for (int i=first_new; i<num_records; i++) {
+                int tick = (int)lround(time_sales[i].Price / sc.TickSize);
+                if (time_sales[i].Type == SC_TS_BID) {
+                    walls.AddTrade(tick, (float)time_sales[i].Volume, WALL_BID);
+                }
+                else if (time_sales[i].Type == SC_TS_ASK) {
+                    walls.AddTrade(tick, (float)time_sales[i].Volume, WALL_ASK);
+                }
+            }
+            p_Snapshot->WallsLatestSequence = time_sales[num_records-1].Sequence;
+        }
+
+        if (changed) {
+            long long now_ms = GetHeatmapTimeMs(sc.CurrentSystemDateTime);
+            int num_ended = 0;
+            for (int side=0; side<2; side++) {
+                const DepthLevels &levels = side == WALL_BID ? bids : asks;
+                std::vector<WallLevel> &wall_levels = p_Snapshot->WallLevels;
+                wall_levels.clear();
+                for (int i=0; i<num_levels && levels.Price[i] > 0; i++) {
+                    wall_levels.push_back(WallLevel{(int)lround(levels.Price[i] / sc.TickSize), levels.Quantity[i]});
+                }
+                num_ended += walls.Update(now_ms, side, wall_levels.data(), (int)wall_levels.size());
+            }
+
+            // the walls that just went away are at the end of the history
+            if (LogWalls.GetYesNo()) {
+                const std::deque<LiquidityWall> &history = walls.GetHistory();
+                for (int i=(int)history.size()-num_ended; i<(int)history.size(); i++) {
+                    const LiquidityWall &wall = history[i];
+                    log_message.Format("%s wall at %.2f lasted %.1fs, peak %.0f, moved %d times, %s",
+                            wall.Side == WALL_BID ? "Bid" : "Ask", wall.Tick * sc.TickSize, wall.GetLifetimeMs(now_ms) / 1000.0,
+                            wall.PeakQty, wall.NumMoves, wall.Outcome == WALL_TRADED_THROUGH ? "traded through" : "pulled");
+                    sc.AddMessageToLog(log_message, 0);
+                }
+            }
+        }
+    }
+
+    // let the GDI call know the book moved
+    if (changed) {
+        bids.Analyse((float)p_Snapshot->FilterMinimum);
+        asks.Analyse((float)p_Snapshot->FilterMinimum);
+        p_Snapshot->Version++;
+    }
+
+    // heatmap history, at most one snapshot every HEATMAP_MIN_INTERVAL_MS
+    if (ShowHeatmap.GetYesNo() && sc.TickSize > 0) {
+        p_Snapshot->HeatmapPending |= changed;
+        long long system_ms = GetHeatmapTimeMs(sc.CurrentSystemDateTime);
+        if (p_Snapshot->HeatmapPending && system_ms - p_Snapshot->HeatmapLastSystemMs >= HEATMAP_MIN_INTERVAL_MS) {
+            std::vector<HeatmapLevel> &levels = p_Snapshot->HeatmapLevels;
+            levels.clear();
+            for (int i=0; i<num_levels; i++) {
+                if (bids.Price[i] > 0) {
+                    levels.push_back(HeatmapLevel{(int)lround(bids.Price[i] / sc.TickSize), bids.Quantity[i]});
+                }
+                if (asks.Price[i] > 0) {
+                    levels.push_back(HeatmapLevel{(int)lround(asks.Price[i] / sc.TickSize), asks.Quantity[i]});
+                }
+            }
+            p_Snapshot->Heatmap.SetBudgetBytes((size_t)HeatmapMemoryMB.GetInt() * 1024 * 1024);
+            p_Snapshot->Heatmap.Add(GetHeatmapTimeMs(sc.LatestDateTimeForLastBar), levels.data(), (int)levels.size());
+            p_Snapshot->HeatmapLastSystemMs = system_ms;
+            p_Snapshot->HeatmapPending = false;
+        }
+    }
 
     // draw
     sc.p_GDIFunction = DrawToChart;
 
 }
 
+// index of the visible bar a heatmap snapshot falls in
+int GetHeatmapBarIndex(SCStudyInterfaceRef sc, long long TimeMs)
+{
+    int lo = sc.IndexOfFirstVisibleBar;
+    int hi = sc.IndexOfLastVisibleBar;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (GetHeatmapTimeMs(sc.BaseDateTimeIn[mid]) <= TimeMs) {
+            lo = mid;
+        }
+        else {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+// left edge of a bar's column in the heatmap
+int GetHeatmapBarX(SCStudyInterfaceRef sc, int BarIndex)
+{
+    return sc.BarIndexToXPixelCoordinate(BarIndex) - sc.ChartBarSpacing / 2;
+}
+
+// decode the visible part of the history into the cached bitmap
+void BuildHeatmap(SCStudyInterfaceRef sc, HDC DeviceContext, DepthSnapshot *p_Snapshot, float vHigh, float vLow, int Opacity)
+{
+    HeatmapBitmap &bmp = p_Snapshot->HeatmapCache;
+    int first_idx = sc.IndexOfFirstVisibleBar;
+    int last_idx = sc.IndexOfLastVisibleBar;
+    int left = GetHeatmapBarX(sc, first_idx);
+    int top = sc.RegionValueToYPixelCoordinate(vHigh, sc.GraphRegion);
+    int width = GetHeatmapBarX(sc, last_idx + 1) - left;
+    int height = sc.RegionValueToYPixelCoordinate(vLow, sc.GraphRegion) - top;
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    // new top down 32 bit bitmap when the size changes
+    if (bmp.Bitmap == NULL || width != bmp.Width || height != bmp.Height) {
+        if (bmp.Bitmap != NULL) {
+            DeleteObject(bmp.Bitmap);
+            bmp.Bitmap = NULL;
+        }
+        BITMAPINFO bmi;
+        memset(&bmi, 0, sizeof(bmi));
+        bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+        bmi.bmiHeader.biWidth = width;
+        bmi.bmiHeader.biHeight = -height;
+        bmi.bmiHeader.biPlanes = 1;
+        bmi.bmiHeader.biBitCount = 32;
+        bmi.bmiHeader.biCompression = BI_RGB;
+        void *p_Bits = NULL;
+        bmp.Bitmap = CreateDIBSection(DeviceContext, &bmi, DIB_RGB_COLORS, &p_Bits, NULL, 0);
+        if (bmp.Bitmap == NULL) {
+            return;
+        }
+        bmp.p_Pixels = (unsigned int *)p_Bits;
+        bmp.Width = width;
+        bmp.Height = height;
+    }
+    bmp.Left = left;
+    bmp.Top = top;
+    memset(bmp.p_Pixels, 0, (size_t)width * height * sizeof(unsigned int));
+
+    // premultiplied colors, blue for thin liquidity up to yellow for the largest size seen
+    const DepthHeatmapHistory &history = p_Snapshot->Heatmap;
+    unsigned int palette[256];
+    float max_q = history.GetMaxQ() > 0 ? history.GetMaxQ() : 1.0f;
+    for (int q=0; q<256; q++) {
+        float r = q / max_q;
+        if (r > 1) r = 1;
+        float red = r < 0.5f ? 0 : (r - 0.5f) * 2 * 255;
+        float green = r < 0.5f ? r * 2 * 200 : 200 + (r - 0.5f) * 2 * 30;
+        float blue = r < 0.5f ? 160 + r * 2 * 40 : 200 - (r - 0.5f) * 2 * 160;
+        float alpha = q == 0 ? 0 : (0.15f + 0.85f * r) * Opacity / 100.0f;
+        palette[q] = ((unsigned int)(alpha * 255) << 24) | ((unsigned int)(red * alpha) << 16)
+            | ((unsigned int)(green * alpha) << 8) | (unsigned int)(blue * alpha);
+    }
+
+    // pixel rows for every visible price
+    int min_tick = (int)floor(vLow / sc.TickSize);
+    int max_tick = (int)ceil(vHigh / sc.TickSize);
+    int num_ticks = max_tick - min_tick + 1;
+    std::vector<int> row_top(num_ticks);
+    std::vector<int> row_bottom(num_ticks);
+    for (int i=0; i<num_ticks; i++) {
+        float price = (min_tick + i) * sc.TickSize;
+        row_top[i] = max(sc.RegionValueToYPixelCoordinate(price + sc.TickSize / 2, sc.GraphRegion) - top, 0);
+        row_bottom[i] = min(sc.RegionValueToYPixelCoordinate(price - sc.TickSize / 2, sc.GraphRegion) - top, height);
+    }
+
+    // each snapshot holds until the next one, paint it across the bars in between
+    std::vector<uint8_t> sizes(num_ticks, 0);
+    int pending_bar = -1;
+    auto paint = [&](int from_bar, int to_bar) {
+        int x0 = max(GetHeatmapBarX(sc, from_bar) - left, 0);
+        int x1 = min(GetHeatmapBarX(sc, to_bar) - left, width);
+        for (int i=0; i<num_ticks; i++) {
+            if (sizes[i] == 0) {
+                continue;
+            }
+            unsigned int color = palette[sizes[i]];
+            for (int y=row_top[i]; y<row_bottom[i]; y++) {
+                unsigned int *p_Row = bmp.p_Pixels + (size_t)y * width;
+                for (int x=x0; x<x1; x++) {
+                    p_Row[x] = color;
+                }
+            }
+        }
+    };
+
+    long long from_ms = GetHeatmapTimeMs(sc.BaseDateTimeIn[first_idx]);
+    long long to_ms = last_idx + 1 < sc.ArraySize ? GetHeatmapTimeMs(sc.BaseDateTimeIn[last_idx + 1]) - 1 : history.GetLastTimeMs();
+    history.Replay(from_ms, to_ms, min_tick, max_tick, [&](long long TimeMs, const uint8_t *p_Sizes, int BaseTick, int NumTicks) {
+        int bar = GetHeatmapBarIndex(sc, TimeMs);
+        if (pending_bar >= 0 && bar > pending_bar) {
+            paint(pending_bar, bar);
+        }
+        for (int i=0; i<num_ticks; i++) {
+            int tick = min_tick + i;
+            sizes[i] = tick >= BaseTick && tick < BaseTick + NumTicks ? p_Sizes[tick - BaseTick] : 0;
+        }
+        pending_bar = bar;
+    });
+    if (pending_bar >= 0) {
+        paint(pending_bar, last_idx + 1);
+    }
+
+    bmp.HistoryVersion = history.Version;
+    bmp.ChartBarSpacing = sc.ChartBarSpacing;
+    bmp.FirstIdx = first_idx;
+    bmp.LastIdx = last_idx;
+    bmp.xFirstBar = sc.BarIndexToXPixelCoordinate(first_idx);
+    bmp.vHigh = vHigh;
+    bmp.vLow = vLow;
+    bmp.Opacity = Opacity;
+}
+
+void DrawHeatmap(HDC DeviceContext, SCStudyInterfaceRef sc, DepthSnapshot *p_Snapshot)
+{
+    if (p_Snapshot->Heatmap.Empty() || sc.TickSize <= 0) {
+        return;
+    }
+    int opacity = sc.Input[7].GetInt();
+    float vHigh, vLow;
+    sc.GetMainGraphVisibleHighAndLow(vHigh, vLow);
+
+    HeatmapBitmap &bmp = p_Snapshot->HeatmapCache;
+    if (bmp.IsStale(p_Snapshot->Heatmap.Version, sc, vHigh, vLow, opacity)) {
+        BuildHeatmap(sc, DeviceContext, p_Snapshot, vHigh, vLow, opacity);
+    }
+    if (bmp.Bitmap == NULL) {
+        return;
+    }
+
+    // per pixel alpha so the bars show through. GdiAlphaBlend is the gdi32 export of
+    // AlphaBlend so the DLL doesn't also need msimg32.lib
+    HDC mem_dc = CreateCompatibleDC(DeviceContext);
+    HGDIOBJ old_bitmap = SelectObject(mem_dc, bmp.Bitmap);
+    BLENDFUNCTION blend = {AC_SRC_OVER, 0, 255, AC_SRC_ALPHA};
+    GdiAlphaBlend(DeviceContext, bmp.Left, bmp.Top, bmp.Width, bmp.Height, mem_dc, 0, 0, bmp.Width, bmp.Height, blend);
+    SelectObject(mem_dc, old_bitmap);
+    DeleteDC(mem_dc);
+}
+
 void DrawToChart(HWND WindowHandle, HDC DeviceContext, SCStudyInterfaceRef sc)
 {
-    int MinimumSize = sc.Input[1].GetInt();
     int VerticalOffset = sc.Input[3].GetInt();
     int HorizontalOffset = sc.Input[4].GetInt();
-    int num_levels = sc.GetPersistentInt(0);
+    // fetch the snapshot built by the study function
+    DepthSnapshot *p_Snapshot = (DepthSnapshot *)sc.GetPersistentPointer(0);
+    if (p_Snapshot == NULL || p_Snapshot->Version == 0) {
+        return;
+    }
+    const DepthLevels &bids = p_Snapshot->Bid;
+    const DepthLevels &asks = p_Snapshot->Ask;
+    int num_levels = p_Snapshot->NumLevels;
+
+    // heatmap goes down first so the sizes print over it
+    if (sc.Input[5].GetYesNo()) {
+        DrawHeatmap(DeviceContext, sc, p_Snapshot);
+    }
+
+    // only re-format the text when depth changed since the last repaint
+    if (p_Snapshot->LabelsVersion != p_Snapshot->Version) {
+        const LiquidityWallTracker &walls = p_Snapshot->Walls;
+        bool only_walls = p_Snapshot->ShowOnlyWalls > 0 && sc.TickSize > 0;
+
+        // stock sizes in thousands of shares, everything else as is
+        NumberFormat size_format(0, sc.SecurityType() == n_ACSIL::SECURITY_TYPE_STOCK ? NUMBER_DIVISOR_THOUSANDS : NUMBER_DIVISOR_NONE);
+        for (int i=0; i<num_levels; i++) {
+            bool show_bid = bids.AboveMinimum[i];
+            bool show_ask = asks.AboveMinimum[i];
+            if (only_walls) {
+                show_bid = walls.Find(WALL_BID, (int)lround(bids.Price[i] / sc.TickSize)) != NULL;
+                show_ask = walls.Find(WALL_ASK, (int)lround(asks.Price[i] / sc.TickSize)) != NULL;
+            }
+            p_Snapshot->BidLabels[i] = "";
+            if (show_bid) {
+                p_Snapshot->BidLabels[i] = p_Snapshot->Numbers.Format(bids.Quantity[i], size_format).Text;
+            }
+            p_Snapshot->AskLabels[i] = "";
+            if (show_ask) {
+                p_Snapshot->AskLabels[i] = p_Snapshot->Numbers.Format(asks.Quantity[i], size_format).Text;
+            }
+        }
+        p_Snapshot->LabelsVersion = p_Snapshot->Version;
+    }
+
     int bidX = sc.BarIndexToXPixelCoordinate(sc.Index) + HorizontalOffset;
     int bidY;
     int askX = bidX;
     int askY;
     SCString msg;
 
-    float plotPrice = 0;
     //msg.Format("tickSize=%f, lastPrice=%f", tickSize, lastPrice);
     //sc.AddMessageToLog(msg, 1);
 
@@ -93,38 +613,28 @@ void DrawToChart(HWND WindowHandle, HDC DeviceContext, SCStudyInterfaceRef sc)
     SetBkMode(DeviceContext, OPAQUE);
 
     SelectObject(DeviceContext, hFont);
-    s_MarketDepthEntry bid_mde;
-    s_MarketDepthEntry ask_mde;        // used for calculating avg lot sizes
+    ::SetTextAlign(DeviceContext, TA_NOUPDATECP);
     for (int i=0; i<num_levels; i++) {
 
-        sc.GetBidMarketDepthEntryAtLevel(bid_mde, i);
-        sc.GetAskMarketDepthEntryAtLevel(ask_mde, i);
-
-        // quantity, price, numorders
-        //log_message.Format("i=%d, BxA=%f x %f, Count BxA=%d x %d", i, (float)bid_mde.Quantity, (float)ask_mde.Quantity, bid_mde.NumOrders, ask_mde.NumOrders);
-        //sc.AddMessageToLog(log_message, 1);
-
-        // calculate coords
-        bidY = sc.RegionValueToYPixelCoordinate(bid_mde.Price, sc.GraphRegion);
-        askY = sc.RegionValueToYPixelCoordinate(ask_mde.Price, sc.GraphRegion);
+        // calculate coords, these move with scrolling so they're done every repaint
+        bidY = sc.RegionValueToYPixelCoordinate(bids.Price[i], sc.GraphRegion);
+        askY = sc.RegionValueToYPixelCoordinate(asks.Price[i], sc.GraphRegion);
 
         // print bid side text on DOM
-        msg.Format("%.0f", bid_mde.Quantity/1000);
-        if (bid_mde.Quantity >= MinimumSize) {
-            ::SetTextAlign(DeviceContext, TA_NOUPDATECP);
-            ::TextOut(DeviceContext, bidX, bidY - VerticalOffset, msg, msg.GetLength());
+        const SCString &bid_label = p_Snapshot->BidLabels[i];
+        if (bid_label.GetLength() > 0) {
+            ::TextOut(DeviceContext, bidX, bidY - VerticalOffset, bid_label, bid_label.GetLength());
         }
 
         // print ask side text to DOM
-        msg.Format("%.0f", ask_mde.Quantity/1000);
-        if (ask_mde.Quantity >= MinimumSize) {
-            ::SetTextAlign(DeviceContext, TA_NOUPDATECP);
-            ::TextOut(DeviceContext, askX, askY - VerticalOffset, msg, msg.GetLength());
+        const SCString &ask_label = p_Snapshot->AskLabels[i];
+        if (ask_label.GetLength() > 0) {
+            ::TextOut(DeviceContext, askX, askY - VerticalOffset, ask_label, ask_label.GetLength());
         }
-
-        // delete font
-        DeleteObject(hFont);
     }
 
+    // delete font
+    DeleteObject(hFont);
+
     return;
 }
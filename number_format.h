@@ -0,0 +1,229 @@
+#pragma once
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <unordered_map>
+
+/*
+    Written by Frozen Tundra
+
+    Number to text for the labels that get drawn on every repaint. Values are scaled
+    and rounded to a whole number of units and written out with integer math, no printf,
+    and the most recent strings are kept in a small LRU so a level that didn't change
+    costs a lookup. Doesn't need sierrachart.h.
+*/
+
+// quantity divisors, stocks trade in round lots of 100 and big depth reads easier in thousands
+const float NUMBER_DIVISOR_NONE = 1;
+const float NUMBER_DIVISOR_ROUND_LOTS = 100;
+const float NUMBER_DIVISOR_THOUSANDS = 1000;
+
+const int NUMBER_FORMAT_MAX_DECIMALS = 3;
+const int NUMBER_FORMAT_CACHE_SIZE = 512;
+
+// past this many units it's printf, same as it always was
+const double NUMBER_FORMAT_MAX_UNITS = 1e15;
+
+struct NumberFormat
+{
+    // Suffix 0 for none, ShowSign puts + on values that aren't negative like %+f
+    NumberFormat(int NumDecimals = 0, float Divisor = NUMBER_DIVISOR_NONE, bool WithSign = false, char WithSuffix = 0)
+    {
+        Decimals = NumDecimals < 0 ? 0 : (NumDecimals > NUMBER_FORMAT_MAX_DECIMALS ? NUMBER_FORMAT_MAX_DECIMALS : NumDecimals);
+        ShowSign = WithSign;
+        Suffix = WithSuffix;
+        Multiplier = Divisor > 0 ? 1.0 / Divisor : 1.0;
+
+        // one multiply per value takes it straight to units
+        Scale = Multiplier;
+        for (int i=0; i<Decimals; i++)
+        {
+            Scale *= 10;
+        }
+    }
+
+    int Decimals;
+    bool ShowSign;
+    char Suffix;
+    double Multiplier;
+    double Scale;
+};
+
+struct NumberLabel
+{
+    char Text[32];
+    int Length = 0;
+};
+
+class NumberFormatter
+{
+    public:
+        NumberFormatter()
+        {
+            m_Entries.reserve(NUMBER_FORMAT_CACHE_SIZE);
+            m_Index.reserve(NUMBER_FORMAT_CACHE_SIZE * 2);
+        }
+
+        // the label stays valid until the next call
+        const NumberLabel& Format(float Value, const NumberFormat &Fmt)
+        {
+            double Scaled = Value * Fmt.Scale;
+
+            // too big for the fast path (or nan), printf it and leave the cache alone
+            if (!(fabs(Scaled) < NUMBER_FORMAT_MAX_UNITS))
+            {
+                const int MaxLength = sizeof(m_Overflow.Text) - 2;
+                int Length = snprintf(m_Overflow.Text, MaxLength + 1, Fmt.ShowSign ? "%+.*f" : "%.*f", Fmt.Decimals, Value * Fmt.Multiplier);
+                Length = Length < 0 ? 0 : (Length > MaxLength ? MaxLength : Length);
+                if (Fmt.Suffix != 0)
+                {
+                    m_Overflow.Text[Length++] = Fmt.Suffix;
+                }
+                m_Overflow.Text[Length] = 0;
+                m_Overflow.Length = Length;
+                return m_Overflow;
+            }
+
+            // round half to even like printf
+            long long Units = llrint(Scaled);
+            uint64_t Key = ((uint64_t)Units << 12) | ((uint64_t)Fmt.Decimals << 9) | ((uint64_t)Fmt.ShowSign << 8) | (uint8_t)Fmt.Suffix;
+            auto Found = m_Index.find(Key);
+            if (Found != m_Index.end())
+            {
+                MoveToFront(Found->second);
+                return m_Entries[Found->second].Label;
+            }
+
+            // new entry until the cache is full, then reuse the least recently used one
+            int Slot;
+            if ((int)m_Entries.size() < NUMBER_FORMAT_CACHE_SIZE)
+            {
+                Slot = (int)m_Entries.size();
+                m_Entries.push_back(Entry());
+            }
+            else
+            {
+                Slot = m_Tail;
+                Unlink(Slot);
+                m_Index.erase(m_Entries[Slot].Key);
+            }
+            Entry &e = m_Entries[Slot];
+            e.Key = Key;
+            Write(Units, Fmt, e.Label);
+            m_Index[Key] = Slot;
+            PushFront(Slot);
+            return e.Label;
+        }
+
+        void Clear()
+        {
+            m_Entries.clear();
+            m_Index.clear();
+            m_Head = -1;
+            m_Tail = -1;
+        }
+
+        // units are the value scaled to the format's last decimal place
+        static void Write(long long Units, const NumberFormat &Fmt, NumberLabel &Label)
+        {
+            // digits come out backwards, and there's always one before the decimal point
+            char Digits[24];
+            int n = 0;
+            unsigned long long u = Units < 0 ? 0ULL - (unsigned long long)Units : (unsigned long long)Units;
+            do
+            {
+                Digits[n++] = (char)('0' + u % 10);
+                u /= 10;
+            } while (u > 0 || n <= Fmt.Decimals);
+
+            char *Out = Label.Text;
+            int Length = 0;
+            if (Units < 0)
+            {
+                Out[Length++] = '-';
+            }
+            else if (Fmt.ShowSign)
+            {
+                Out[Length++] = '+';
+            }
+            while (n > 0)
+            {
+                if (n == Fmt.Decimals)
+                {
+                    Out[Length++] = '.';
+                }
+                Out[Length++] = Digits[--n];
+            }
+            if (Fmt.Suffix != 0)
+            {
+                Out[Length++] = Fmt.Suffix;
+            }
+            Out[Length] = 0;
+            Label.Length = Length;
+        }
+
+    private:
+        struct Entry
+        {
+            uint64_t Key = 0;
+            int Prev = -1;
+            int Next = -1;
+            NumberLabel Label;
+        };
+
+        // entries linked most recently used first
+        std::vector<Entry> m_Entries;
+        std::unordered_map<uint64_t, int> m_Index;
+        int m_Head = -1;
+        int m_Tail = -1;
+        NumberLabel m_Overflow;
+
+        void Unlink(int Slot)
+        {
+            Entry &e = m_Entries[Slot];
+            if (e.Prev >= 0)
+            {
+                m_Entries[e.Prev].Next = e.Next;
+            }
+            else
+            {
+                m_Head = e.Next;
+            }
+            if (e.Next >= 0)
+            {
+                m_Entries[e.Next].Prev = e.Prev;
+            }
+            else
+            {
+                m_Tail = e.Prev;
+            }
+            e.Prev = -1;
+            e.Next = -1;
+        }
+
+        void PushFront(int Slot)
+        {
+            Entry &e = m_Entries[Slot];
+            e.Prev = -1;
+            e.Next = m_Head;
+            if (m_Head >= 0)
+            {
+                m_Entries[m_Head].Prev = Slot;
+            }
+            m_Head = Slot;
+            if (m_Tail < 0)
+            {
+                m_Tail = Slot;
+            }
+        }
+
+        void MoveToFront(int Slot)
+        {
+            if (Slot != m_Head)
+            {
+                Unlink(Slot);
+                PushFront(Slot);
+            }
+        }
+};
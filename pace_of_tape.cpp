@@ -1,5 +1,9 @@
 #include "sierrachart.h"
 #include <vector>
+#include <string>
+#include <unordered_map>
+#include <chrono>
+#include <algorithm>
 SCDLLName("Frozen Tundra - Pace of Tape")
 
 /*
@@ -15,6 +19,11 @@ struct RecordsPerUnit {
     // number of records tallied for this second in time
     int NumRecords;
 
+    // same tally split by aggressor side
+    // bid = sellers hitting the bid, ask = buyers lifting the offer
+    int NumBidRecords;
+    int NumAskRecords;
+
     int MaxRecords;
 };
 
@@ -59,6 +68,750 @@ struct GlobalLineNumbers {
 
 GlobalLineNumbers g_LineNumbers;
 
+// minimum number of milliseconds between T&S fetches for the same symbol.
+// every instance updating within this window reuses the last fetch.
+const int PACE_ENGINE_MIN_FETCH_MS = 20;
+
+// absolute second (days since epoch * 86400 + time of day), never wraps at midnight
+long long GetAbsSecond(const SCDateTime& DateTime)
+{
+    return((long long)DateTime.GetDate() * 86400 + DateTime.GetTimeInSeconds());
+}
+
+// one second of executions, split by aggressor side
+struct PaceBucket {
+    // absolute second (date + time of day) this bucket holds, -1 = empty
+    long long AbsSecond = -1;
+
+    // sellers hitting the bid
+    int BidTicks = 0;
+    int BidVolume = 0;
+
+    // buyers lifting the offer
+    int AskTicks = 0;
+    int AskVolume = 0;
+};
+
+// T&S pace engine for a single symbol.
+// Ingests new T&S records once, no matter how many Pace of Tape instances
+// are watching the symbol, and keeps a rolling per-second histogram.
+// Ticks vs volume and every window length are derived from the same
+// 1 second buckets, so one engine serves all instances.
+struct SymbolPaceEngine {
+    // ring of per-second buckets, indexed by AbsSecond % Buckets.size()
+    std::vector<PaceBucket> Buckets;
+
+    // most recent second seen on the tape, -1 = nothing ingested yet
+    long long NewestSecond = -1;
+
+    // T&S sequence number of the last ingested record
+    int LatestSequence = 0;
+
+    // time of day in ms of the last T&S fetch, -1 = never fetched
+    int LastFetchMs = -1;
+
+    // subscribed instances => number of seconds each needs
+    std::unordered_map<long long, int> Subscribers;
+
+    // largest window any subscriber asked for
+    int RequiredSeconds() {
+        int Required = 1;
+        for (auto& Sub: Subscribers) {
+            if (Sub.second > Required) Required = Sub.second;
+        }
+        return(Required);
+    }
+
+    // forget everything ingested so far, next fetch re-reads the whole tape
+    void Reset() {
+        for (int i=0; i<Buckets.size(); i++) {
+            Buckets[i] = PaceBucket();
+        }
+        NewestSecond = -1;
+        LatestSequence = 0;
+        LastFetchMs = -1;
+    }
+
+    // make sure the ring covers the largest subscribed window
+    void Resize() {
+        // 2 spare buckets so the second currently being filled never
+        // overwrites the oldest second of the largest window
+        int NeededSize = RequiredSeconds() + 2;
+        if (Buckets.size() >= NeededSize) return;
+        Buckets.resize(NeededSize);
+        Reset();
+    }
+
+    // tally executions
+    void AddExecution(long long AbsSecond, int Type, int Volume, int NumTicks) {
+        if (Buckets.size() == 0) return;
+        PaceBucket& Bucket = Buckets[AbsSecond % Buckets.size()];
+        if (Bucket.AbsSecond != AbsSecond) {
+            // second rolled over, recycle this bucket
+            Bucket = PaceBucket();
+            Bucket.AbsSecond = AbsSecond;
+        }
+        if (Type == SC_TS_BID) {
+            Bucket.BidTicks += NumTicks;
+            Bucket.BidVolume += Volume;
+        }
+        else if (Type == SC_TS_ASK) {
+            Bucket.AskTicks += NumTicks;
+            Bucket.AskVolume += Volume;
+        }
+    }
+
+    // tally an intraday file record.
+    // tick by tick files hold a single trade per record, otherwise
+    // the record's trades are split between sides by its bid/ask volume.
+    void AddIntradayRecord(const s_IntradayRecord& Record) {
+        long long AbsSecond = GetAbsSecond(Record.DateTime);
+        if (AbsSecond > NewestSecond) NewestSecond = AbsSecond;
+
+        int BidVolume = Record.BidVolume;
+        int AskVolume = Record.AskVolume;
+        int TotalVolume = BidVolume + AskVolume;
+        if (TotalVolume <= 0) return;
+
+        int NumTrades = Record.NumTrades;
+        int BidTrades = (int)(((long long)NumTrades * BidVolume + TotalVolume/2) / TotalVolume);
+        int AskTrades = NumTrades - BidTrades;
+        if (BidVolume > 0) AddExecution(AbsSecond, SC_TS_BID, BidVolume, BidTrades);
+        if (AskVolume > 0) AddExecution(AbsSecond, SC_TS_ASK, AskVolume, AskTrades);
+    }
+
+    // returns the bucket for a given second, or NULL if there were no executions
+    // during that second or it has already rolled out of the ring
+    const PaceBucket* GetBucket(long long AbsSecond) {
+        if (Buckets.size() == 0 || AbsSecond < 0) return(NULL);
+        const PaceBucket& Bucket = Buckets[AbsSecond % Buckets.size()];
+        if (Bucket.AbsSecond != AbsSecond) return(NULL);
+        return(&Bucket);
+    }
+
+    // fills Records with one entry per second for the NumSeconds seconds before LastAbsSecond
+    // 0 = ticks
+    // 1 = volume
+    void GetRecords(long long LastAbsSecond, int NumSeconds, int TicksOrVolume, std::vector<RecordsPerUnit>& Records) {
+        Records.clear();
+        int LastTimeInSec = (int)(LastAbsSecond % 86400);
+        int StartTimeInSec = LastTimeInSec - NumSeconds;
+        for (int i=0; i<NumSeconds; i++) {
+            RecordsPerUnit tmp;
+            tmp.TimeInSeconds = StartTimeInSec + i;
+            tmp.NumRecords = 0;
+            tmp.NumBidRecords = 0;
+            tmp.NumAskRecords = 0;
+
+            const PaceBucket* Bucket = GetBucket(LastAbsSecond - NumSeconds + i);
+            if (Bucket != NULL) {
+                if (TicksOrVolume == 0) {
+                    tmp.NumBidRecords = Bucket->BidTicks;
+                    tmp.NumAskRecords = Bucket->AskTicks;
+                }
+                else if (TicksOrVolume == 1) {
+                    tmp.NumBidRecords = Bucket->BidVolume;
+                    tmp.NumAskRecords = Bucket->AskVolume;
+                }
+                tmp.NumRecords = tmp.NumBidRecords + tmp.NumAskRecords;
+            }
+            Records.push_back(tmp);
+        }
+    }
+
+    // fetch T&S for the symbol and ingest only records we haven't seen
+    void Update(SCStudyInterfaceRef sc, const SCString& Symbol) {
+        // someone else already fetched the tape moments ago
+        int NowMs = sc.CurrentSystemDateTime.GetTimeInMilliseconds();
+        if (LastFetchMs >= 0 && NowMs >= LastFetchMs && NowMs - LastFetchMs < PACE_ENGINE_MIN_FETCH_MS) {
+            return;
+        }
+        LastFetchMs = NowMs;
+
+        // NOTE: MAKE SURE TO UPDATE GLOBAL SETTINGS -> NUM TIME AND SALES RECORDS!
+        c_SCTimeAndSalesArray TimeSales;
+        sc.GetTimeAndSalesForSymbol(Symbol, TimeSales);
+        int NumRecords = TimeSales.Size();
+        if (NumRecords == 0) return;
+
+        // tape went backwards (reconnect, replay restart), start over
+        if (TimeSales[NumRecords-1].Sequence < LatestSequence) {
+            Reset();
+            LastFetchMs = NowMs;
+        }
+
+        // walk back from the end to the first record we haven't processed yet
+        int FirstNew = NumRecords;
+        while (FirstNew > 0 && (LatestSequence == 0 || TimeSales[FirstNew-1].Sequence > LatestSequence)) {
+            FirstNew--;
+        }
+
+        for (int i=FirstNew; i<NumRecords; i++) {
+            long long AbsSecond = GetAbsSecond(TimeSales[i].DateTime);
+
+            // any record, including L2 updates, moves the clock forward
+            if (AbsSecond > NewestSecond) NewestSecond = AbsSecond;
+
+            // if this is an L2 update, skip it, if its an execution, process it
+            int ts_Type = TimeSales[i].Type;
+            if (ts_Type == SC_TS_BID || ts_Type == SC_TS_ASK) {
+                AddExecution(AbsSecond, ts_Type, TimeSales[i].Volume, 1);
+            }
+        }
+        LatestSequence = TimeSales[NumRecords-1].Sequence;
+    }
+};
+
+// process-wide pace engines, one per symbol, shared by every instance of this study
+struct GlobalPaceEngines {
+    std::unordered_map<std::string, SymbolPaceEngine> Engines;
+
+    // unique key for a study instance across charts
+    static long long SubscriberKey(SCStudyInterfaceRef sc) {
+        return(((long long)sc.ChartNumber << 32) | (unsigned int)sc.StudyGraphInstanceID);
+    }
+
+    // register (or update) an instance's interest in a symbol
+    SymbolPaceEngine& Subscribe(const std::string& Symbol, long long Key, int NumSeconds) {
+        SymbolPaceEngine& Engine = Engines[Symbol];
+        Engine.Subscribers[Key] = NumSeconds;
+        Engine.Resize();
+        return(Engine);
+    }
+
+    // drop an instance, and the engine with it once nobody is watching the symbol
+    void Unsubscribe(const std::string& Symbol, long long Key) {
+        auto Found = Engines.find(Symbol);
+        if (Found == Engines.end()) return;
+        Found->second.Subscribers.erase(Key);
+        if (Found->second.Subscribers.size() == 0) {
+            Engines.erase(Found);
+        }
+    }
+};
+
+GlobalPaceEngines g_PaceEngines;
+
+// P-squared streaming quantile estimator (Jain & Chlamtac, 1985).
+// Tracks a single quantile in constant memory with 5 markers whose heights
+// are nudged with a parabolic fit as observations arrive.
+struct P2Quantile {
+    // quantile being tracked, 0 to 1
+    double p = 0.5;
+
+    // number of observations seen
+    int Count = 0;
+
+    // marker heights, actual positions, desired positions, desired position increments
+    double q[5] = {0, 0, 0, 0, 0};
+    double n[5] = {0, 0, 0, 0, 0};
+    double np[5] = {0, 0, 0, 0, 0};
+    double dn[5] = {0, 0, 0, 0, 0};
+
+    void Reset(double Percentile) {
+        p = Percentile;
+        Count = 0;
+    }
+
+    void Add(double x) {
+        // first 5 observations seed the markers
+        if (Count < 5) {
+            q[Count++] = x;
+            if (Count == 5) {
+                std::sort(q, q+5);
+                for (int i=0; i<5; i++) n[i] = i+1;
+                np[0] = 1; np[1] = 1+2*p; np[2] = 1+4*p; np[3] = 3+2*p; np[4] = 5;
+                dn[0] = 0; dn[1] = p/2;   dn[2] = p;     dn[3] = (1+p)/2; dn[4] = 1;
+            }
+            return;
+        }
+
+        // find the cell x falls in, extending the extremes if needed
+        int k = 0;
+        if (x < q[0]) {
+            q[0] = x;
+            k = 0;
+        }
+        else if (x >= q[4]) {
+            q[4] = x;
+            k = 3;
+        }
+        else {
+            while (k < 3 && x >= q[k+1]) k++;
+        }
+        for (int i=k+1; i<5; i++) n[i]++;
+        for (int i=0; i<5; i++) np[i] += dn[i];
+        Count++;
+
+        // adjust the middle markers that drifted off their desired positions
+        for (int i=1; i<=3; i++) {
+            double d = np[i] - n[i];
+            if ((d >= 1 && n[i+1] - n[i] > 1) || (d <= -1 && n[i-1] - n[i] < -1)) {
+                int s = d >= 0 ? 1 : -1;
+                double qp = q[i] + (double)s / (n[i+1] - n[i-1])
+                    * ((n[i] - n[i-1] + s) * (q[i+1] - q[i]) / (n[i+1] - n[i])
+                     + (n[i+1] - n[i] - s) * (q[i] - q[i-1]) / (n[i] - n[i-1]));
+                if (q[i-1] < qp && qp < q[i+1]) {
+                    q[i] = qp;
+                }
+                else {
+                    // parabola overshot a neighbour, fall back to linear
+                    q[i] = q[i] + s * (q[i+s] - q[i]) / (n[i+s] - n[i]);
+                }
+                n[i] += s;
+            }
+        }
+    }
+
+    double Get() {
+        if (Count == 0) return(0);
+        if (Count < 5) {
+            // not seeded yet, exact quantile of what we have
+            double tmp[5];
+            std::copy(q, q+Count, tmp);
+            std::sort(tmp, tmp+Count);
+            return(tmp[(int)(p * (Count-1) + 0.5)]);
+        }
+        return(q[2]);
+    }
+};
+
+// reference percentiles offered for session normalization
+const int NUM_PACE_PERCENTILES = 5;
+const double PACE_PERCENTILES[NUM_PACE_PERCENTILES] = {0.50, 0.75, 0.90, 0.95, 0.99};
+
+// session-long distribution of records per second, one estimator per offered percentile
+struct PaceQuantiles {
+    P2Quantile Estimators[NUM_PACE_PERCENTILES];
+
+    // last completed second fed to the estimators, -1 = none yet
+    long long LastRolledSecond = -1;
+
+    // trading day the estimators belong to
+    int SessionDate = -1;
+
+    // ticks or volume the estimators were fed with
+    int TicksOrVolume = -1;
+
+    void Reset(int NewSessionDate, int NewTicksOrVolume) {
+        for (int i=0; i<NUM_PACE_PERCENTILES; i++) {
+            Estimators[i].Reset(PACE_PERCENTILES[i]);
+        }
+        SessionDate = NewSessionDate;
+        TicksOrVolume = NewTicksOrVolume;
+    }
+
+    // feed every second that completed since the last roll.
+    // only seconds still held in the engine's ring can be fed, so this needs
+    // to be called at least once per ring length worth of seconds.
+    void Roll(SymbolPaceEngine& Engine, int NewTicksOrVolume, int CurrentSessionDate) {
+        if (CurrentSessionDate != SessionDate || NewTicksOrVolume != TicksOrVolume) {
+            Reset(CurrentSessionDate, NewTicksOrVolume);
+        }
+
+        // the newest second is still filling up
+        long long LastCompleted = Engine.NewestSecond - 1;
+        long long First = LastRolledSecond + 1;
+        long long OldestHeld = Engine.NewestSecond - ((long long)Engine.Buckets.size() - 2);
+        if (First < OldestHeld) First = OldestHeld;
+
+        for (long long Second=First; Second<=LastCompleted; Second++) {
+            int NumRecords = 0;
+            const PaceBucket* Bucket = Engine.GetBucket(Second);
+            if (Bucket != NULL) {
+                if (TicksOrVolume == 0) {
+                    NumRecords = Bucket->BidTicks + Bucket->AskTicks;
+                }
+                else if (TicksOrVolume == 1) {
+                    NumRecords = Bucket->BidVolume + Bucket->AskVolume;
+                }
+            }
+            for (int i=0; i<NUM_PACE_PERCENTILES; i++) {
+                Estimators[i].Add(NumRecords);
+            }
+        }
+        if (LastCompleted > LastRolledSecond) LastRolledSecond = LastCompleted;
+    }
+};
+
+// market regimes by pace of tape
+enum PaceRegime {
+    PACE_REGIME_QUIET = 0,
+    PACE_REGIME_NORMAL,
+    PACE_REGIME_FAST,
+    PACE_REGIME_EXTREME
+};
+
+const char* PACE_REGIME_NAMES[] = {"Quiet", "Normal", "Fast", "Extreme"};
+
+// thresholds for moving between regimes
+struct PaceRegimeSettings {
+    // pace of tape boundaries between quiet|normal, normal|fast and fast|extreme
+    float Boundaries[3];
+
+    // pace has to fall this far below a boundary before dropping back down
+    float Hysteresis;
+
+    // seconds a regime has to last before another transition is allowed
+    int MinDwellSeconds;
+};
+
+// a single regime transition
+struct PaceRegimeEvent {
+    // system time the transition was detected
+    SCDateTime DateTime;
+
+    // chart bar the transition happened on
+    int BarIndex;
+
+    int FromRegime;
+    int ToRegime;
+
+    // pace of tape that triggered the transition
+    float PaceOfTape;
+};
+
+// persistent pointer key other studies use to find the event ring, see PaceRegimeEvents
+const int PACE_REGIME_EVENTS_KEY = 1;
+const int PACE_REGIME_EVENTS_SIZE = 64;
+
+// Fixed size ring of the most recent regime transitions.
+// Other studies read it with:
+//   PaceRegimeEvents* p_Events = (PaceRegimeEvents*)sc.GetPersistentPointerFromChartStudy(ChartNumber, StudyID, PACE_REGIME_EVENTS_KEY);
+// and keep their own count of events consumed, comparing it against TotalEvents.
+struct PaceRegimeEvents {
+    // number of events ever written, the newest is at (TotalEvents-1) % PACE_REGIME_EVENTS_SIZE
+    unsigned int TotalEvents = 0;
+
+    PaceRegimeEvent Events[PACE_REGIME_EVENTS_SIZE];
+
+    void Push(const PaceRegimeEvent& Event) {
+        Events[TotalEvents % PACE_REGIME_EVENTS_SIZE] = Event;
+        TotalEvents++;
+    }
+
+    // fetch event number EventNumber (0 = first event ever written),
+    // false if it hasn't happened yet or was already overwritten
+    bool Get(unsigned int EventNumber, PaceRegimeEvent& Event) {
+        if (EventNumber >= TotalEvents) return(false);
+        if (TotalEvents - EventNumber > PACE_REGIME_EVENTS_SIZE) return(false);
+        Event = Events[EventNumber % PACE_REGIME_EVENTS_SIZE];
+        return(true);
+    }
+};
+
+// quiet/normal/fast/extreme state machine with hysteresis and minimum dwell time,
+// advanced once per pace calculation
+struct PaceRegimeTracker {
+    int Regime = PACE_REGIME_NORMAL;
+
+    // tape second the current regime started, -1 = no pace seen yet
+    long long RegimeStartSecond = -1;
+
+    // returns true when the regime changed, FromRegime is set to the regime we left
+    bool Update(float PaceOfTape, long long NowSecond, const PaceRegimeSettings& Settings, int& FromRegime) {
+        if (RegimeStartSecond < 0) RegimeStartSecond = NowSecond;
+
+        // going up only needs the boundary, going down needs to clear the hysteresis band
+        int Target = Regime;
+        while (Target < PACE_REGIME_EXTREME && PaceOfTape >= Settings.Boundaries[Target]) {
+            Target++;
+        }
+        while (Target > PACE_REGIME_QUIET && PaceOfTape < Settings.Boundaries[Target-1] - Settings.Hysteresis) {
+            Target--;
+        }
+        if (Target == Regime) return(false);
+
+        // hasn't been in this regime long enough
+        if (NowSecond - RegimeStartSecond < Settings.MinDwellSeconds) return(false);
+
+        FromRegime = Regime;
+        Regime = Target;
+        RegimeStartSecond = NowSecond;
+        return(true);
+    }
+};
+
+// study inputs needed to calculate pace, shared by the live and backfill paths
+struct PaceSettings {
+    int NumSecondsToExamine;
+    int NumSquares;
+
+    // 0 = ticks, 1 = volume
+    int TicksOrVolume;
+
+    // 0 = original, 1 = lagging max
+    int CalcMethod;
+
+    // 0 = window max, 1 = session percentile
+    int Normalization;
+
+    // index into PACE_PERCENTILES
+    int PercentileIdx;
+
+    PaceRegimeSettings Regime;
+};
+
+// pace metrics calculated over a window of per-second records
+struct PaceResult {
+    // quick avg of records per second, what the gauge shows as "current"
+    int CurrNumRecords = 0;
+
+    // max (or lagging max) records per second within the window,
+    // or the session percentile when normalizing by session
+    int MaxRecordsPerSecond = 1;
+
+    // CurrNumRecords / MaxRecordsPerSecond
+    // can exceed 1 when normalizing by session percentile
+    float PaceOfTape = 0;
+
+    // quick avg window sums split by aggressor side
+    int QuickBidSum = 0;
+    int QuickAskSum = 0;
+
+    // buyers and sellers records per second over the quick avg window
+    float BuyPace = 0;
+    float SellPace = 0;
+
+    // -1 = all sellers, 0 = balanced, +1 = all buyers
+    float Imbalance = 0;
+};
+
+// calculates the pace of tape for a window of records.
+// shared by the live T&S path and the historical backfill so both produce identical values.
+void CalculatePace(std::vector<RecordsPerUnit>& Records, const PaceSettings& Settings, int LastTimeInSec, PaceResult& Result)
+{
+    int NumSecondsToExamine = Settings.NumSecondsToExamine;
+    int NumSquares = Settings.NumSquares;
+    int CalcMethod = Settings.CalcMethod;
+
+    // calculate the max ticks/sec and overall avg
+    int SumRecords = 0;
+    float AvgRecords = 0;
+    int MaxRecordsPerSecond = 0;
+    int MaxRecordsTimeInSec = 0;
+    for (int i=0; i<NumSecondsToExamine; i++) {
+        //msg.Format("%d %d = %d", i, Records[i].TimeInSeconds, Records[i].NumRecords);
+        //sc.AddMessageToLog(msg, 1);
+        SumRecords += Records[i].NumRecords;
+        if (Records[i].NumRecords > MaxRecordsPerSecond) {
+
+            if (CalcMethod == 1 && (Records[i].TimeInSeconds < LastTimeInSec - (NumSecondsToExamine/NumSquares))) {
+                // "lagging maximum" calculation
+                // only set the max when it isn't happening right now, otherwise
+                // we'll never see the gauge max out during rapid pace
+                MaxRecordsPerSecond = Records[i].NumRecords;
+                MaxRecordsTimeInSec = Records[i].TimeInSeconds;
+            }
+            else {
+                // original calculation
+                // set max whenever a new max records is found
+                MaxRecordsPerSecond = Records[i].NumRecords;
+                MaxRecordsTimeInSec = Records[i].TimeInSeconds;
+            }
+
+            Records[i].MaxRecords = MaxRecordsPerSecond;
+        }
+    }
+    AvgRecords = SumRecords / NumSecondsToExamine;
+
+    // calculate quick avg to help with jerkyness
+    // dynamically adjust quick avg's length depending on number of squares to be drawn
+    int QuickAvgLength = NumSecondsToExamine / NumSquares;
+    int QuickSum = 0;
+    int QuickBidSum = 0;
+    int QuickAskSum = 0;
+    float QuickAvg = 0;
+    for (int i=NumSecondsToExamine-1-QuickAvgLength; i<NumSecondsToExamine; i++) {
+        //msg.Format("%d %d = %d", i, Records[i].TimeInSeconds, Records[i].NumRecords);
+        //sc.AddMessageToLog(msg, 1);
+        QuickSum += Records[i].NumRecords;
+        QuickBidSum += Records[i].NumBidRecords;
+        QuickAskSum += Records[i].NumAskRecords;
+    }
+    QuickAvg = QuickSum / QuickAvgLength;
+
+    // buyers vs sellers pace over the same quick avg window
+    float BuyPace = (float)QuickAskSum / (float)QuickAvgLength;
+    float SellPace = (float)QuickBidSum / (float)QuickAvgLength;
+
+    // -1 = all sellers, 0 = balanced, +1 = all buyers
+    float Imbalance = 0;
+    if (QuickAskSum + QuickBidSum > 0) {
+        Imbalance = (float)(QuickAskSum - QuickBidSum) / (float)(QuickAskSum + QuickBidSum);
+    }
+
+    // int CurrNumRecords = Records[NumSecondsToExamine-1].NumRecords;
+    int CurrNumRecords = QuickAvg;
+
+    // safety check/min feel check
+    if (CurrNumRecords == 0) CurrNumRecords = Records[NumSecondsToExamine-1].NumRecords;
+
+    // modify the max because we're never hitting the max again
+    //MaxRecordsPerSecond = MaxRecordsPerSecond - QuickAvg;
+
+    // safety checks
+    if (MaxRecordsPerSecond == 0) MaxRecordsPerSecond = 1;
+
+    // calculate the pace of tape percentage
+    float PaceOfTape = (float)CurrNumRecords / (float)MaxRecordsPerSecond;
+
+    Result.CurrNumRecords = CurrNumRecords;
+    Result.MaxRecordsPerSecond = MaxRecordsPerSecond;
+    Result.PaceOfTape = PaceOfTape;
+    Result.QuickBidSum = QuickBidSum;
+    Result.QuickAskSum = QuickAskSum;
+    Result.BuyPace = BuyPace;
+    Result.SellPace = SellPace;
+    Result.Imbalance = Imbalance;
+}
+
+// swaps the window max for the session percentile as the 100% reference.
+// one outlier second no longer pins the gauge low for the rest of the window.
+// falls back to the window max until the session has seen a full window of seconds.
+void NormalizePace(const PaceSettings& Settings, PaceQuantiles& Quantiles, PaceResult& Result)
+{
+    if (Settings.Normalization != 1) return;
+    if (Settings.PercentileIdx < 0 || Settings.PercentileIdx >= NUM_PACE_PERCENTILES) return;
+
+    P2Quantile& Estimator = Quantiles.Estimators[Settings.PercentileIdx];
+    if (Estimator.Count < Settings.NumSecondsToExamine) return;
+
+    int Reference = (int)(Estimator.Get() + 0.5);
+    if (Reference < 1) Reference = 1;
+    Result.MaxRecordsPerSecond = Reference;
+    Result.PaceOfTape = (float)Result.CurrNumRecords / (float)Reference;
+}
+
+// writes the pace subgraphs at a given bar index
+void SetPaceSubgraphs(SCStudyInterfaceRef sc, int Index, const PaceResult& Pace)
+{
+    sc.Subgraph[0][Index] = Pace.CurrNumRecords;
+    sc.Subgraph[1][Index] = Pace.MaxRecordsPerSecond;
+    sc.Subgraph[2][Index] = Pace.PaceOfTape;
+    sc.Subgraph[3][Index] = Pace.BuyPace;
+    sc.Subgraph[4][Index] = Pace.SellPace;
+    sc.Subgraph[5][Index] = Pace.Imbalance;
+}
+
+// per-instance state, stored in persistent pointer 0
+struct PaceInstance {
+    // symbol this instance is subscribed to in g_PaceEngines
+    std::string Symbol;
+
+    // session distribution of the live tape, kept across recalcs
+    PaceQuantiles LiveQuantiles;
+
+    // live regime and its published transitions
+    PaceRegimeTracker LiveRegime;
+    PaceRegimeEvents RegimeEvents;
+
+    // private engine fed from the intraday file for historical bars
+    SymbolPaceEngine Backfill;
+    PaceQuantiles BackfillQuantiles;
+    PaceRegimeTracker BackfillRegime;
+
+    // next bar and record within that bar to read for the backfill
+    int BackfillIndex = 0;
+    int BackfillSubIndex = 0;
+
+    // every historical bar has been calculated
+    bool BackfillDone = false;
+
+    // start the backfill over from the first bar
+    void ResetBackfill() {
+        Backfill.Reset();
+        BackfillQuantiles = PaceQuantiles();
+        BackfillRegime = PaceRegimeTracker();
+        BackfillIndex = 0;
+        BackfillSubIndex = 0;
+        BackfillDone = false;
+    }
+};
+
+// Calculates the pace subgraphs for every historical bar from the chart's intraday file,
+// feeding each bar's records through the same engine and calculation the live T&S path uses.
+// Records are read ChunkSize at a time while holding the file lock, and the work is spread
+// across study calls so a single call never takes much longer than BudgetMs.
+void BackfillPace(SCStudyInterfaceRef sc, PaceInstance& Instance, const PaceSettings& Settings, int BudgetMs, int ChunkSize)
+{
+    int NumSecondsToExamine = Settings.NumSecondsToExamine;
+
+    if (Instance.BackfillDone) return;
+
+    // the backfill engine only ever serves this instance's window
+    SymbolPaceEngine& Engine = Instance.Backfill;
+    if (Engine.Buckets.size() != NumSecondsToExamine + 2) {
+        Engine.Buckets.resize(NumSecondsToExamine + 2);
+        Instance.ResetBackfill();
+    }
+
+    if (ChunkSize < 1) ChunkSize = 1;
+
+    // the live bar is handled by the T&S path
+    int LastHistoricalIndex = sc.ArraySize - 2;
+
+    std::vector<RecordsPerUnit> Records;
+    PaceResult Pace;
+    s_IntradayRecord IntradayRecord;
+    auto StartTime = std::chrono::steady_clock::now();
+
+    while (Instance.BackfillIndex <= LastHistoricalIndex) {
+
+        // read one chunk of records under a single lock
+        bool FirstIteration = true;
+        for (int NumRead=0; NumRead<ChunkSize && Instance.BackfillIndex <= LastHistoricalIndex; NumRead++) {
+
+            // on first iteration, place lock on intraday file
+            IntradayFileLockActionEnum IntradayFileLockAction = IFLA_NO_CHANGE;
+            if (FirstIteration) {
+                IntradayFileLockAction = IFLA_LOCK_READ_HOLD;
+                FirstIteration = false;
+            }
+
+            int ReadSuccess = sc.ReadIntradayFileRecordForBarIndexAndSubIndex(Instance.BackfillIndex, Instance.BackfillSubIndex, IntradayRecord, IntradayFileLockAction);
+            if (ReadSuccess) {
+                Engine.AddIntradayRecord(IntradayRecord);
+                Instance.BackfillSubIndex++;
+
+                // a second rolled over, feed it to the session distribution
+                if (Engine.NewestSecond - 1 > Instance.BackfillQuantiles.LastRolledSecond) {
+                    Instance.BackfillQuantiles.Roll(Engine, Settings.TicksOrVolume, sc.GetTradingDayDate(sc.BaseDateTimeIn[Instance.BackfillIndex]));
+                }
+                continue;
+            }
+
+            // no more records in this bar, calculate pace as of the bar's last record
+            if (Engine.NewestSecond >= 0) {
+                Engine.GetRecords(Engine.NewestSecond, NumSecondsToExamine, Settings.TicksOrVolume, Records);
+                CalculatePace(Records, Settings, (int)(Engine.NewestSecond % 86400), Pace);
+                NormalizePace(Settings, Instance.BackfillQuantiles, Pace);
+                SetPaceSubgraphs(sc, Instance.BackfillIndex, Pace);
+
+                // regimes for history only go to the subgraph, the event ring is for the live tape
+                int FromRegime = 0;
+                Instance.BackfillRegime.Update(Pace.PaceOfTape, Engine.NewestSecond, Settings.Regime, FromRegime);
+                sc.Subgraph[6][Instance.BackfillIndex] = Instance.BackfillRegime.Regime;
+            }
+            Instance.BackfillIndex++;
+            Instance.BackfillSubIndex = 0;
+        }
+
+        // done with this chunk, release lock so Sierra can keep writing the file
+        if (!FirstIteration) {
+            sc.ReadIntradayFileRecordForBarIndexAndSubIndex(-1, -1, IntradayRecord, IFLA_RELEASE_AFTER_READ);
+        }
+
+        // out of time for this call, pick up where we left off next call
+        auto Elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - StartTime);
+        if (Elapsed.count() >= BudgetMs) break;
+    }
+
+    if (Instance.BackfillIndex > LastHistoricalIndex) {
+        Instance.BackfillDone = true;
+    }
+}
+
 SCSFExport scsf_PaceOfTape(SCStudyInterfaceRef sc)
 {
     // logging object
@@ -86,11 +839,29 @@ SCSFExport scsf_PaceOfTape(SCStudyInterfaceRef sc)
     SCInputRef i_FontSize = sc.Input[++InputIdx];
     SCInputRef i_DrawTrails = sc.Input[++InputIdx];
     SCInputRef i_TrailsNumSeconds = sc.Input[++InputIdx];
+    SCInputRef i_AggressorGauge = sc.Input[++InputIdx];
+    SCInputRef i_BuyColor = sc.Input[++InputIdx];
+    SCInputRef i_SellColor = sc.Input[++InputIdx];
+    SCInputRef i_Backfill = sc.Input[++InputIdx];
+    SCInputRef i_BackfillBudgetMs = sc.Input[++InputIdx];
+    SCInputRef i_BackfillChunkSize = sc.Input[++InputIdx];
+    SCInputRef i_Normalization = sc.Input[++InputIdx];
+    SCInputRef i_ReferencePercentile = sc.Input[++InputIdx];
+    SCInputRef i_QuietBelow = sc.Input[++InputIdx];
+    SCInputRef i_FastAbove = sc.Input[++InputIdx];
+    SCInputRef i_ExtremeAbove = sc.Input[++InputIdx];
+    SCInputRef i_RegimeHysteresis = sc.Input[++InputIdx];
+    SCInputRef i_RegimeMinDwell = sc.Input[++InputIdx];
+    SCInputRef i_RegimeAlertNumber = sc.Input[++InputIdx];
 
     // subgraphs
     SCSubgraphRef s_Current = sc.Subgraph[0];
     SCSubgraphRef s_Max     = sc.Subgraph[1];
     SCSubgraphRef s_PoT     = sc.Subgraph[2];
+    SCSubgraphRef s_BuyPace   = sc.Subgraph[3];
+    SCSubgraphRef s_SellPace  = sc.Subgraph[4];
+    SCSubgraphRef s_Imbalance = sc.Subgraph[5];
+    SCSubgraphRef s_Regime    = sc.Subgraph[6];
 
     // Set configuration variables
     if (sc.SetDefaults)
@@ -163,6 +934,51 @@ SCSFExport scsf_PaceOfTape(SCStudyInterfaceRef sc)
         i_TrailsNumSeconds.Name = "> # Seconds of Trails";
         i_TrailsNumSeconds.SetInt(10);
 
+        i_AggressorGauge.Name = "Split Gauge Colors by Buyers/Sellers?";
+        i_AggressorGauge.SetYesNo(0);
+
+        i_BuyColor.Name = "> Buy (ask side) Color";
+        i_BuyColor.SetColor(000,200,000);
+
+        i_SellColor.Name = "> Sell (bid side) Color";
+        i_SellColor.SetColor(200,000,000);
+
+        i_Backfill.Name = "Backfill History from Intraday File? (chart symbol only)";
+        i_Backfill.SetYesNo(0);
+
+        i_BackfillBudgetMs.Name = "> Backfill Time Budget per Update (ms)";
+        i_BackfillBudgetMs.SetInt(20);
+        i_BackfillBudgetMs.SetIntLimits(1, 1000);
+
+        i_BackfillChunkSize.Name = "> Backfill Records Read per File Lock";
+        i_BackfillChunkSize.SetInt(5000);
+        i_BackfillChunkSize.SetIntLimits(1, 1000000);
+
+        i_Normalization.Name = "Pace 100% Reference";
+        i_Normalization.SetCustomInputStrings("Max Within Window;Session Percentile");
+        i_Normalization.SetCustomInputIndex(0);
+
+        i_ReferencePercentile.Name = "> Session Percentile";
+        i_ReferencePercentile.SetCustomInputStrings("50th;75th;90th;95th;99th");
+        i_ReferencePercentile.SetCustomInputIndex(2);
+
+        i_QuietBelow.Name = "Regime: Quiet Below Pace (0-1+)";
+        i_QuietBelow.SetFloat(0.25f);
+
+        i_FastAbove.Name = "Regime: Fast At/Above Pace";
+        i_FastAbove.SetFloat(0.60f);
+
+        i_ExtremeAbove.Name = "Regime: Extreme At/Above Pace";
+        i_ExtremeAbove.SetFloat(0.90f);
+
+        i_RegimeHysteresis.Name = "Regime: Hysteresis Before Dropping a Regime";
+        i_RegimeHysteresis.SetFloat(0.05f);
+
+        i_RegimeMinDwell.Name = "Regime: Minimum Seconds in a Regime";
+        i_RegimeMinDwell.SetInt(5);
+
+        i_RegimeAlertNumber.Name = "Regime: Alert Sound Number on Change (0=off)";
+        i_RegimeAlertNumber.SetInt(0);
 
         // subgraphs
         s_Current.Name      = "Current Rate";
@@ -173,6 +989,18 @@ SCSFExport scsf_PaceOfTape(SCStudyInterfaceRef sc)
 
         s_PoT.Name      = "Pace of Tape";
         s_PoT.DrawStyle = DRAWSTYLE_IGNORE;
+
+        s_BuyPace.Name      = "Buy Rate";
+        s_BuyPace.DrawStyle = DRAWSTYLE_IGNORE;
+
+        s_SellPace.Name      = "Sell Rate";
+        s_SellPace.DrawStyle = DRAWSTYLE_IGNORE;
+
+        s_Imbalance.Name      = "Buy/Sell Pace Imbalance";
+        s_Imbalance.DrawStyle = DRAWSTYLE_IGNORE;
+
+        s_Regime.Name      = "Pace Regime (0=Quiet 1=Normal 2=Fast 3=Extreme)";
+        s_Regime.DrawStyle = DRAWSTYLE_IGNORE;
         return;
     }
 
@@ -181,9 +1009,6 @@ SCSFExport scsf_PaceOfTape(SCStudyInterfaceRef sc)
     // we need to count backwards in time from the last (most recent) execution that occurred
     int NumSecondsToExamine = i_NumRecordsToExamine.GetInt();
 
-    // struct to store raw T&S data
-    c_SCTimeAndSalesArray TimeSales;
-
     // symbol we'll be fetching T&S data on
     SCString SymbolToUse;
     // check the input for referencing a diff symbol
@@ -193,158 +1018,130 @@ SCSFExport scsf_PaceOfTape(SCStudyInterfaceRef sc)
         SymbolToUse = sc.Symbol;
     }
 
-    // NOTE: MAKE SURE TO UPDATE GLOBAL SETTINGS -> NUM TIME AND SALES RECORDS!
-    // grab latest time and sales data to fetch the most recent tick.
-    sc.GetTimeAndSalesForSymbol(SymbolToUse, TimeSales);
-
-    // PROBLEM - no tape found, bomb out
-    if (TimeSales.Size() == 0) {
-        //msg.Format("ERROR: GetTimeAndSales() returned 0 records for %s", SymbolToUse.GetChars());
-        //sc.AddMessageToLog(msg, 1);
-        return;
-    }
-
-    // if user has study set to hidden, don't add drawing objects
-    if (sc.HideStudy) return;
-
     // number of squares to draw
     int NumSquares = i_NumSquares.GetInt();
 
-    // we'll store totals of trades in a vector of this structure
-    std::vector<RecordsPerUnit> Records;
-    Records.clear();
-
     // safety check
     if (NumSecondsToExamine < NumSquares) NumSecondsToExamine = NumSquares;
 
-    // number of records returned by SC for the T&S data
-    int NumRecords = TimeSales.Size();
-
-    // fetch the DateTime obj for the most recent tick
-    SCDateTime LastDT = TimeSales[NumRecords-1].DateTime;
-
-    // grab the integer representation of time in seconds
-    int LastTimeInSec = LastDT.GetTimeInSeconds();
-
-    // count backwards to get the "start" time we'll be examining
-    int StartTimeInSec = LastTimeInSec - NumSecondsToExamine;
+    // per-instance state
+    PaceInstance* p_Instance = (PaceInstance*)sc.GetPersistentPointer(0);
+    if (p_Instance == NULL) {
+        p_Instance = new PaceInstance;
+        sc.SetPersistentPointer(0, p_Instance);
+    }
+    long long SubscriberKey = GlobalPaceEngines::SubscriberKey(sc);
 
-// msg.Format("%d records found for %s, Start=%d, Last=%d, GoBack=%d", NumRecords, SymbolToUse.GetChars(), StartTimeInSec, LastTimeInSec, GoBackCounter);
-// sc.AddMessageToLog(msg, 1);
+    // study removed or chart closed, stop watching the symbol
+    if (sc.LastCallToFunction) {
+        if (!p_Instance->Symbol.empty()) {
+            g_PaceEngines.Unsubscribe(p_Instance->Symbol, SubscriberKey);
+        }
+        delete p_Instance;
+        sc.SetPersistentPointer(0, NULL);
+        sc.SetPersistentPointer(PACE_REGIME_EVENTS_KEY, NULL);
+        return;
+    }
 
-    // instantiate our struct based on the number of seconds we wish to examine
-    for (int i=0; i<NumSecondsToExamine; i++) {
-        RecordsPerUnit tmp;
-        tmp.TimeInSeconds = StartTimeInSec + i;
-        tmp.NumRecords = 0;
-        Records.push_back(tmp);
+    // symbol input changed, move our subscription over
+    std::string Symbol = SymbolToUse.GetChars();
+    if (!p_Instance->Symbol.empty() && p_Instance->Symbol != Symbol) {
+        g_PaceEngines.Unsubscribe(p_Instance->Symbol, SubscriberKey);
     }
+    p_Instance->Symbol = Symbol;
 
-    // grab first tick's time
-    //int FirstTimeInSec = Records[0].TimeInSeconds;
+    // publish regime transitions for other studies
+    sc.SetPersistentPointer(PACE_REGIME_EVENTS_KEY, &p_Instance->RegimeEvents);
 
+    // shared engine does the T&S fetch at most once per update for all instances on this symbol
+    SymbolPaceEngine& Engine = g_PaceEngines.Subscribe(Symbol, SubscriberKey, NumSecondsToExamine);
+    Engine.Update(sc, SymbolToUse);
+
+    PaceSettings Settings;
+    Settings.NumSecondsToExamine = NumSecondsToExamine;
+    Settings.NumSquares = NumSquares;
     // 0 = ticks
     // 1 = volume
-    int TicksOrVolume = i_TicksOrVolume.GetIndex();
-
-    // start storing # ticks at the start time up to end time
-    for (int i=0; i<NumRecords; i++) {
-
-        // grab next tick's time
-        SCDateTime ts_DateTime = TimeSales[i].DateTime;
-
-        // grab integer representation of time in seconds
-        int TimeInSec = ts_DateTime.GetTimeInSeconds();
-
-// msg.Format("%d >=? %d ==> %d", StartTimeInSec, TimeInSec, StartTimeInSec >= TimeInSec);
-// sc.AddMessageToLog(msg, 1);
-//return;
-
-        // skip anything before our intended start time
-        if (TimeInSec < StartTimeInSec) continue;
-
-        // grab the SIDE of the execution (Bid or Ask)
-        int ts_Type = TimeSales[i].Type;
-
-        // if this is an L2 update, skip it, if its an execution, process it
-        if (ts_Type == SC_TS_BID || ts_Type == SC_TS_ASK) {
-            // find the correct index in the Records struct
-            int MatchingIdx = -1;
-            for (int j=0; j<NumSecondsToExamine; j++) {
-                if (Records[j].TimeInSeconds == TimeInSec) {
-                    MatchingIdx = j;
-                    break;
-                }
-            }
-            if (MatchingIdx >= 0) {
-                // add this tick to this idx
-                if (TicksOrVolume == 0) {
-                    Records[MatchingIdx].NumRecords++;
-                }
-                else if (TicksOrVolume == 1) {
-                    Records[MatchingIdx].NumRecords += TimeSales[i].Volume;
-                }
-            }
+    Settings.TicksOrVolume = i_TicksOrVolume.GetIndex();
+    Settings.CalcMethod = i_CalcMethod.GetIndex();
+    Settings.Normalization = i_Normalization.GetIndex();
+    Settings.PercentileIdx = i_ReferencePercentile.GetIndex();
+    Settings.Regime.Boundaries[0] = i_QuietBelow.GetFloat();
+    Settings.Regime.Boundaries[1] = i_FastAbove.GetFloat();
+    Settings.Regime.Boundaries[2] = i_ExtremeAbove.GetFloat();
+    Settings.Regime.Hysteresis = i_RegimeHysteresis.GetFloat();
+    Settings.Regime.MinDwellSeconds = i_RegimeMinDwell.GetInt();
+    int TicksOrVolume = Settings.TicksOrVolume;
+
+    // historical bars come from the intraday file, which only exists for the chart's own symbol
+    bool Backfill = i_Backfill.GetYesNo() && SymbolToUse == sc.Symbol;
+    if (Backfill) {
+        // subgraphs were cleared, start over
+        if (sc.IsFullRecalculation && sc.UpdateStartIndex == 0) {
+            p_Instance->ResetBackfill();
         }
+
+        // only the live bar is fed from T&S, work on history once per update
+        if (sc.Index < sc.ArraySize-1) return;
+        BackfillPace(sc, *p_Instance, Settings, i_BackfillBudgetMs.GetInt(), i_BackfillChunkSize.GetInt());
     }
 
-    // calculate the max ticks/sec and overall avg
-    int CalcMethod = i_CalcMethod.GetIndex();
-    int SumRecords = 0;
-    float AvgRecords = 0;
-    int MaxRecordsPerSecond = 0;
-    int MaxRecordsTimeInSec = 0;
-    for (int i=0; i<NumSecondsToExamine; i++) {
-        //msg.Format("%d %d = %d", i, Records[i].TimeInSeconds, Records[i].NumRecords);
+    // PROBLEM - no tape found, bomb out
+    if (Engine.NewestSecond < 0) {
+        //msg.Format("ERROR: GetTimeAndSales() returned 0 records for %s", SymbolToUse.GetChars());
         //sc.AddMessageToLog(msg, 1);
-        SumRecords += Records[i].NumRecords;
-        if (Records[i].NumRecords > MaxRecordsPerSecond) {
+        return;
+    }
 
-            if (CalcMethod == 1 && (Records[i].TimeInSeconds < LastTimeInSec - (NumSecondsToExamine/NumSquares))) {
-                // "lagging maximum" calculation
-                // only set the max when it isn't happening right now, otherwise
-                // we'll never see the gauge max out during rapid pace
-                MaxRecordsPerSecond = Records[i].NumRecords;
-                MaxRecordsTimeInSec = Records[i].TimeInSeconds;
-            }
-            else {
-                // original calculation
-                // set max whenever a new max records is found
-                MaxRecordsPerSecond = Records[i].NumRecords;
-                MaxRecordsTimeInSec = Records[i].TimeInSeconds;
-            }
+    // feed newly completed seconds to the session distribution, even when hidden
+    p_Instance->LiveQuantiles.Roll(Engine, TicksOrVolume, sc.GetTradingDayDate(sc.BaseDateTimeIn[sc.ArraySize-1]));
 
-            Records[i].MaxRecords = MaxRecordsPerSecond;
-        }
-    }
-    AvgRecords = SumRecords / NumSecondsToExamine;
+    // we'll store totals of trades in a vector of this structure
+    std::vector<RecordsPerUnit> Records;
 
-    // calculate quick avg to help with jerkyness
-    // dynamically adjust quick avg's length depending on number of squares to be drawn
-    int QuickAvgLength = NumSecondsToExamine / NumSquares;
-    int QuickSum = 0;
-    float QuickAvg = 0;
-    for (int i=NumSecondsToExamine-1-QuickAvgLength; i<NumSecondsToExamine; i++) {
-        //msg.Format("%d %d = %d", i, Records[i].TimeInSeconds, Records[i].NumRecords);
-        //sc.AddMessageToLog(msg, 1);
-        QuickSum += Records[i].NumRecords;
-    }
-    QuickAvg = QuickSum / QuickAvgLength;
+    // most recent second on the tape
+    long long LastAbsSecond = Engine.NewestSecond;
 
-    // int CurrNumRecords = Records[NumSecondsToExamine-1].NumRecords;
-    int CurrNumRecords = QuickAvg;
+    // grab the integer representation of time in seconds
+    int LastTimeInSec = (int)(LastAbsSecond % 86400);
 
-    // safety check/min feel check
-    if (CurrNumRecords == 0) CurrNumRecords = Records[NumSecondsToExamine-1].NumRecords;
+    // pull our window out of the engine's per-second histogram
+    Engine.GetRecords(LastAbsSecond, NumSecondsToExamine, TicksOrVolume, Records);
 
-    // modify the max because we're never hitting the max again
-    //MaxRecordsPerSecond = MaxRecordsPerSecond - QuickAvg;
+    // calculate the max ticks/sec, quick avg and buy/sell split
+    PaceResult Pace;
+    CalculatePace(Records, Settings, LastTimeInSec, Pace);
+    NormalizePace(Settings, p_Instance->LiveQuantiles, Pace);
 
-    // safety checks
-    if (MaxRecordsPerSecond == 0) MaxRecordsPerSecond = 1;
+    // populate subgraphs
+    SetPaceSubgraphs(sc, sc.Index, Pace);
+
+    // advance the regime and publish any transition
+    int FromRegime = 0;
+    if (p_Instance->LiveRegime.Update(Pace.PaceOfTape, LastAbsSecond, Settings.Regime, FromRegime)) {
+        PaceRegimeEvent Event;
+        Event.DateTime = sc.CurrentSystemDateTime;
+        Event.BarIndex = sc.Index;
+        Event.FromRegime = FromRegime;
+        Event.ToRegime = p_Instance->LiveRegime.Regime;
+        Event.PaceOfTape = Pace.PaceOfTape;
+        p_Instance->RegimeEvents.Push(Event);
+
+        int AlertNumber = i_RegimeAlertNumber.GetInt();
+        if (AlertNumber > 0) {
+            msg.Format("Pace of Tape %s: %s -> %s (%.0f%%)", SymbolToUse.GetChars(), PACE_REGIME_NAMES[FromRegime], PACE_REGIME_NAMES[Event.ToRegime], 100*Pace.PaceOfTape);
+            sc.SetAlert(AlertNumber, msg);
+        }
+    }
+    s_Regime[sc.Index] = p_Instance->LiveRegime.Regime;
 
-    // calculate the pace of tape percentage
-    float PaceOfTape = (float)CurrNumRecords / (float)MaxRecordsPerSecond;
+    // if user has study set to hidden, don't add drawing objects
+    if (sc.HideStudy) return;
+    int CurrNumRecords = Pace.CurrNumRecords;
+    int MaxRecordsPerSecond = Pace.MaxRecordsPerSecond;
+    float PaceOfTape = Pace.PaceOfTape;
+    int QuickBidSum = Pace.QuickBidSum;
+    int QuickAskSum = Pace.QuickAskSum;
 
     // calculate number of squares to color in based on PoT
     int NumSquaresToColor = PaceOfTape * NumSquares;
@@ -360,6 +1157,9 @@ SCSFExport scsf_PaceOfTape(SCStudyInterfaceRef sc)
     // more safety checks
     if (PaceOfTape * 100 == 0) NumSquaresToColor = 0;
 
+    // pace can run past the session percentile, the gauge just maxes out
+    if (NumSquaresToColor > NumSquares) NumSquaresToColor = NumSquares;
+
 //  msg.Format("%d/%d = PoT %.2f, color %d/%d", CurrNumRecords, MaxRecordsPerSecond, PaceOfTape, NumSquaresToColor, NumSquares);
 //  sc.AddMessageToLog(msg, 1);
 
@@ -419,6 +1219,17 @@ SCSFExport scsf_PaceOfTape(SCStudyInterfaceRef sc)
     // 1 = circles
     int Shape = i_Shape.GetIndex();
 
+    // two color gauge, filled squares are split between buyers and sellers
+    bool SplitGauge = i_AggressorGauge.GetYesNo();
+    COLORREF BuyColor = i_BuyColor.GetColor();
+    COLORREF SellColor = i_SellColor.GetColor();
+
+    // number of the colored squares that belong to buyers
+    int BuySquares = 0;
+    if (SplitGauge && QuickBidSum + QuickAskSum > 0) {
+        BuySquares = (int)((float)NumSquaresToColor * QuickAskSum / (QuickBidSum + QuickAskSum) + 0.5f);
+    }
+
     // trails
     bool DrawTrails = i_DrawTrails.GetYesNo();
     int TrailsNumSeconds = i_TrailsNumSeconds.GetInt();
@@ -497,6 +1308,13 @@ SCSFExport scsf_PaceOfTape(SCStudyInterfaceRef sc)
             if (NumSquares == NumSquaresToColor && cursor == NumSquares-1) {
                 Tool.TransparencyLevel = 0;
                 Tool.SecondaryColor = EndColor;
+                if (SplitGauge) {
+                    Tool.SecondaryColor = cursor < BuySquares ? BuyColor : SellColor;
+                }
+            }
+            // buyers fill from the start of the gauge, sellers fill the rest
+            else if (SplitGauge && cursor < NumSquaresToColor) {
+                Tool.SecondaryColor = cursor < BuySquares ? BuyColor : SellColor;
             }
             // paint the rectangle with the calculated gradient RGB value based on where it is located
             else if (cursor < NumSquaresToColor) {
@@ -535,6 +1353,15 @@ SCSFExport scsf_PaceOfTape(SCStudyInterfaceRef sc)
 
                 if (TrailsNumSquaresToColor > cursor) {
                     Tool.SecondaryColor = RGB(StartR+(cursor*RInterval), StartG+(cursor*GInterval), StartB+(cursor*BInterval));
+                    if (SplitGauge) {
+                        int BidRecords = Records[NumSecondsToExamine-j].NumBidRecords;
+                        int AskRecords = Records[NumSecondsToExamine-j].NumAskRecords;
+                        int TrailsBuySquares = 0;
+                        if (BidRecords + AskRecords > 0) {
+                            TrailsBuySquares = (int)((float)TrailsNumSquaresToColor * AskRecords / (BidRecords + AskRecords) + 0.5f);
+                        }
+                        Tool.SecondaryColor = cursor < TrailsBuySquares ? BuyColor : SellColor;
+                    }
                 }
                 else {
                     //Tool.SecondaryColor = sc.ChartBackgroundColor;
@@ -550,11 +1377,6 @@ SCSFExport scsf_PaceOfTape(SCStudyInterfaceRef sc)
         }
     }
 
-    // populate subgraphs
-    s_Current[sc.Index] = CurrNumRecords;
-    s_Max[sc.Index] = MaxRecordsPerSecond;
-    s_PoT[sc.Index] = PaceOfTape;
-
     // contracts vs shares for text
     bool IsStock = sc.SecurityType() == n_ACSIL::SECURITY_TYPE_STOCK;
 
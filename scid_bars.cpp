@@ -0,0 +1,526 @@
+#define NOMINMAX
+#include "scid_reader.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+using std::vector;
+using std::min;
+using std::max;
+
+/*
+    Written by Frozen Tundra
+
+    Rebuilds bars straight from a .scid tick file, outside of Sierra Chart.
+    Records are split into chunks, each chunk is aggregated on its own thread
+    and bars that straddle chunk boundaries are stitched back together.
+
+    Build:
+        g++ -O2 -std=c++17 -pthread scid_bars.cpp -o scid_bars
+        cl /O2 /EHsc /std:c++17 scid_bars.cpp
+
+    Usage:
+        scid_bars <file.scid> <time|trades|volume> <size> [--date YYYY-MM-DD] [--threads N]
+                  [--utc-offset HOURS] [--session-start HH:MM[:SS]]
+        scid_bars --bench <file.scid> <size in GB>
+
+    Bar sizes follow n_ACSIL::s_BarPeriod:
+        time    IBPT_DAYS_MINS_SECS, seconds per bar
+        trades  IBPT_NUM_TRADES_PER_BAR, trades per bar
+        volume  IBPT_VOLUME_PER_BAR, volume per bar
+
+    Times are in the chart time zone, --utc-offset hours from UTC (default 0), and
+    --date picks a calendar day in it. Every bar type starts a new bar at the session
+    start (default 00:00). Time bars are aligned to the session start. Trade and volume
+    bars close as soon as they reach the bar size, the record that gets them there
+    stays whole in that bar and the next record starts a new one.
+
+    Each chunk is built as if a bar started at its first record. Stitching carries the
+    open bar into the next chunk and redoes that chunk's records one at a time until a
+    bar starts on a record where the chunk's own bars start too, from there on they're
+    the same and are taken as is. Time bars line up at the first new bar, trade and
+    volume bars can take longer and in the worst case the whole chunk is redone.
+*/
+
+enum BarType
+{
+    BAR_TIME,
+    BAR_TRADES,
+    BAR_VOLUME
+};
+
+struct Bar
+{
+    // time bars: bar start in chart time, unused for trade/volume bars
+    int64_t Key;
+
+    // index of the bar's first record in the records being aggregated
+    uint64_t FirstRecord;
+    int64_t FirstDateTime;
+    int64_t LastDateTime;
+    float Open;
+    float High;
+    float Low;
+    float Close;
+    uint64_t NumTrades;
+    uint64_t Volume;
+    uint64_t BidVolume;
+    uint64_t AskVolume;
+};
+
+struct BarSettings
+{
+    BarType Type;
+    int64_t Size;
+
+    // chart time zone as microseconds from UTC, and the session start in it
+    int64_t UtcOffset = 0;
+    int64_t SessionStart = 0;
+};
+
+// start of the session a record is in, in chart time
+int64_t GetSessionBegin(const BarSettings& Settings, int64_t DateTime)
+{
+    int64_t Local = DateTime + Settings.UtcOffset;
+    int64_t SinceSession = (Local - Settings.SessionStart) % SCID_MICROSECONDS_PER_DAY;
+    if (SinceSession < 0)
+    {
+        SinceSession += SCID_MICROSECONDS_PER_DAY;
+    }
+    return(Local - SinceSession);
+}
+
+// start of the time bar a record is in, in chart time
+int64_t GetTimeBarStart(const BarSettings& Settings, int64_t DateTime)
+{
+    int64_t SessionBegin = GetSessionBegin(Settings, DateTime);
+    int64_t SinceSession = DateTime + Settings.UtcOffset - SessionBegin;
+    return(SessionBegin + SinceSession - SinceSession % (Settings.Size * 1000000LL));
+}
+
+void AddRecord(Bar& CurrBar, const ScidRecord& Record)
+{
+    // single trades keep bid/ask in High/Low, only Close is the trade price
+    float Open = Record.Close;
+    float High = Record.Close;
+    float Low = Record.Close;
+    if (!ScidIsSingleTrade(Record))
+    {
+        Open = Record.Open;
+        High = Record.High;
+        Low = Record.Low;
+    }
+
+    // first record of the bar
+    if (CurrBar.NumTrades == 0)
+    {
+        CurrBar.FirstDateTime = Record.DateTime;
+        CurrBar.Open = Open;
+        CurrBar.High = High;
+        CurrBar.Low = Low;
+    }
+    CurrBar.LastDateTime = Record.DateTime;
+    CurrBar.High = max(CurrBar.High, High);
+    CurrBar.Low = min(CurrBar.Low, Low);
+    CurrBar.Close = Record.Close;
+    CurrBar.NumTrades += max(Record.NumTrades, 1u);
+    CurrBar.Volume += Record.TotalVolume;
+    CurrBar.BidVolume += Record.BidVolume;
+    CurrBar.AskVolume += Record.AskVolume;
+}
+
+// builds bars one record at a time, oldest first
+struct BarBuilder
+{
+    Bar CurrBar = {};
+    bool HaveBar = false;
+
+    // trade/volume bars: session the open bar is in
+    int64_t Session = 0;
+
+    // the record can't go in the open bar
+    bool StartsNewBar(const BarSettings& Settings, const ScidRecord& Record) const
+    {
+        if (!HaveBar)
+        {
+            return(true);
+        }
+        if (Settings.Type == BAR_TIME)
+        {
+            return(GetTimeBarStart(Settings, Record.DateTime) != CurrBar.Key);
+        }
+        return(GetSessionBegin(Settings, Record.DateTime) != Session);
+    }
+
+    void Add(const BarSettings& Settings, const ScidRecord& Record, uint64_t RecordIdx, vector<Bar>& Bars)
+    {
+        if (StartsNewBar(Settings, Record))
+        {
+            Flush(Bars);
+            CurrBar = Bar();
+            CurrBar.Key = Settings.Type == BAR_TIME ? GetTimeBarStart(Settings, Record.DateTime) : 0;
+            CurrBar.FirstRecord = RecordIdx;
+            Session = Settings.Type == BAR_TIME ? 0 : GetSessionBegin(Settings, Record.DateTime);
+            HaveBar = true;
+        }
+        AddRecord(CurrBar, Record);
+
+        // full, the record that filled it stays whole in it
+        if ((Settings.Type == BAR_TRADES && CurrBar.NumTrades >= (uint64_t)Settings.Size)
+            || (Settings.Type == BAR_VOLUME && CurrBar.Volume >= (uint64_t)Settings.Size))
+        {
+            Flush(Bars);
+        }
+    }
+
+    void Flush(vector<Bar>& Bars)
+    {
+        if (HaveBar)
+        {
+            Bars.push_back(CurrBar);
+            HaveBar = false;
+        }
+    }
+};
+
+// bars closed inside one chunk, and the bar still open at its end
+struct ChunkBars
+{
+    vector<Bar> Bars;
+    BarBuilder End;
+};
+
+// aggregate one chunk as if a bar starts at its first record, FirstRecord is its index overall
+void AggregateChunk(const ScidSpan& Records, const BarSettings& Settings, uint64_t FirstRecord, ChunkBars& Result)
+{
+    BarBuilder Builder;
+    for (size_t i=0; i<Records.size(); i++)
+    {
+        Builder.Add(Settings, Records[i], FirstRecord + i, Result.Bars);
+    }
+    Result.End = Builder;
+}
+
+// the chunk has a bar starting at this record, Next is moved up to it
+bool HasBarStartingAt(const ChunkBars& Part, uint64_t RecordIdx, size_t& Next)
+{
+    while (Next < Part.Bars.size() && Part.Bars[Next].FirstRecord < RecordIdx)
+    {
+        Next++;
+    }
+    if (Next < Part.Bars.size())
+    {
+        return(Part.Bars[Next].FirstRecord == RecordIdx);
+    }
+    return(Part.End.HaveBar && Part.End.CurrBar.FirstRecord == RecordIdx);
+}
+
+void BuildBars(const ScidSpan& Records, const BarSettings& Settings, int NumThreads, vector<Bar>& Bars)
+{
+    Bars.clear();
+    if (Records.empty())
+    {
+        return;
+    }
+
+    // one contiguous chunk per thread
+    size_t NumChunks = min((size_t)max(NumThreads, 1), Records.size());
+    size_t ChunkSize = (Records.size() + NumChunks - 1) / NumChunks;
+    vector<ScidSpan> Chunks;
+    for (size_t Start = 0; Start < Records.size(); Start += ChunkSize)
+    {
+        ScidSpan Chunk;
+        Chunk.Data = Records.Data + Start;
+        Chunk.Count = min(ChunkSize, Records.size() - Start);
+        Chunks.push_back(Chunk);
+    }
+
+    vector<ChunkBars> Parts(Chunks.size());
+    vector<std::thread> Workers;
+    for (size_t i=0; i<Chunks.size(); i++)
+    {
+        Workers.emplace_back([&, i]() {
+            AggregateChunk(Chunks[i], Settings, i * ChunkSize, Parts[i]);
+        });
+    }
+    for (std::thread &Worker : Workers)
+    {
+        Worker.join();
+    }
+
+    // stitch, carry the open bar into the next chunk until its bars line up with ours
+    BarBuilder Carry;
+    for (size_t i=0; i<Chunks.size(); i++)
+    {
+        const ChunkBars &Part = Parts[i];
+        size_t Next = 0;
+        bool InSync = false;
+        for (size_t r=0; r<Chunks[i].size(); r++)
+        {
+            uint64_t RecordIdx = i * ChunkSize + r;
+            if (Carry.StartsNewBar(Settings, Chunks[i][r]) && HasBarStartingAt(Part, RecordIdx, Next))
+            {
+                InSync = true;
+                break;
+            }
+            Carry.Add(Settings, Chunks[i][r], RecordIdx, Bars);
+        }
+        if (InSync)
+        {
+            Carry.Flush(Bars);
+            Bars.insert(Bars.end(), Part.Bars.begin() + Next, Part.Bars.end());
+            Carry = Part.End;
+        }
+    }
+    Carry.Flush(Bars);
+}
+
+// record DateTime => "YYYY-MM-DD HH:MM:SS.mmm"
+std::string FormatDateTime(int64_t DateTime)
+{
+    // days since 1899-12-30 => civil date
+    int64_t Days = DateTime / SCID_MICROSECONDS_PER_DAY;
+    int64_t Micros = DateTime % SCID_MICROSECONDS_PER_DAY;
+    int64_t z = Days - 25569 + 719468; // 1899-12-30 => 1970-01-01 => 0000-03-01
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    int64_t doe = z - era * 146097;
+    int64_t yoe = (doe - doe/1460 + doe/36524 - doe/146096) / 365;
+    int64_t doy = doe - (365*yoe + yoe/4 - yoe/100);
+    int64_t mp = (5*doy + 2) / 153;
+    int Day = (int)(doy - (153*mp + 2)/5 + 1);
+    int Month = (int)(mp < 10 ? mp + 3 : mp - 9);
+    int Year = (int)(yoe + era * 400 + (Month <= 2));
+
+    char Buffer[64];
+    snprintf(Buffer, sizeof(Buffer), "%04d-%02d-%02d %02d:%02d:%02d.%03d", Year, Month, Day,
+        (int)(Micros / 3600000000LL), (int)(Micros / 60000000LL % 60), (int)(Micros / 1000000LL % 60), (int)(Micros / 1000 % 1000));
+    return(Buffer);
+}
+
+// "HH:MM" or "HH:MM:SS" => microseconds since midnight
+bool ParseTimeOfDay(const char* Text, int64_t& TimeOfDay)
+{
+    int Hour = 0, Minute = 0, Second = 0;
+    if (sscanf(Text, "%d:%d:%d", &Hour, &Minute, &Second) < 2 || Hour < 0 || Hour > 23 || Minute < 0 || Minute > 59 || Second < 0 || Second > 59)
+    {
+        return(false);
+    }
+    TimeOfDay = ((Hour * 60LL + Minute) * 60 + Second) * 1000000LL;
+    return(true);
+}
+
+// "YYYY-MM-DD" => record DateTime at midnight
+bool ParseDate(const char* Text, int64_t& DateTime)
+{
+    int Year, Month, Day;
+    if (sscanf(Text, "%d-%d-%d", &Year, &Month, &Day) != 3)
+    {
+        return(false);
+    }
+    Year -= Month <= 2;
+    int64_t era = (Year >= 0 ? Year : Year - 399) / 400;
+    int64_t yoe = Year - era * 400;
+    int64_t doy = (153 * (Month + (Month > 2 ? -3 : 9)) + 2) / 5 + Day - 1;
+    int64_t doe = yoe * 365 + yoe/4 - yoe/100 + doy;
+    int64_t Days = era * 146097 + doe - 719468 + 25569;
+    DateTime = Days * SCID_MICROSECONDS_PER_DAY;
+    return(true);
+}
+
+// synthetic tick file for benchmarking, random walk of single trades
+bool GenerateFile(const std::string& Path, double SizeGB)
+{
+    FILE *File = fopen(Path.c_str(), "wb");
+    if (File == NULL)
+    {
+        return(false);
+    }
+
+    ScidHeader Header = {};
+    memcpy(Header.FileTypeUniqueHeaderID, "SCID", 4);
+    Header.HeaderSize = sizeof(ScidHeader);
+    Header.RecordSize = sizeof(ScidRecord);
+    Header.Version = 1;
+    fwrite(&Header, sizeof(Header), 1, File);
+
+    uint64_t NumRecords = (uint64_t)(SizeGB * 1024 * 1024 * 1024 / sizeof(ScidRecord));
+    int64_t DateTime = 45000LL * SCID_MICROSECONDS_PER_DAY;
+    float Price = 4000.0f;
+    uint32_t Random = 12345;
+    vector<ScidRecord> Block(1 << 20);
+    for (uint64_t Written = 0; Written < NumRecords; )
+    {
+        size_t Count = (size_t)min<uint64_t>(Block.size(), NumRecords - Written);
+        for (size_t i=0; i<Count; i++)
+        {
+            Random = Random * 1664525 + 1013904223;
+            DateTime += 1000 + (Random >> 20);
+            Price += (Random >> 31) ? 0.25f : -0.25f;
+            bool AtAsk = (Random >> 8) & 1;
+            uint32_t Volume = 1 + ((Random >> 10) & 15);
+
+            ScidRecord &Record = Block[i];
+            Record.DateTime = DateTime;
+            Record.Open = SCID_SINGLE_TRADE_WITH_BID_ASK;
+            Record.High = Price + 0.25f;
+            Record.Low = Price;
+            Record.Close = AtAsk ? Price + 0.25f : Price;
+            Record.NumTrades = 1;
+            Record.TotalVolume = Volume;
+            Record.BidVolume = AtAsk ? 0 : Volume;
+            Record.AskVolume = AtAsk ? Volume : 0;
+        }
+        if (fwrite(Block.data(), sizeof(ScidRecord), Count, File) != Count)
+        {
+            fclose(File);
+            return(false);
+        }
+        Written += Count;
+    }
+    fclose(File);
+    return(true);
+}
+
+int RunBenchmark(const std::string& Path, double SizeGB)
+{
+    ScidReader Reader;
+    if (!Reader.Open(Path))
+    {
+        fprintf(stderr, "generating %.1f GB at %s\n", SizeGB, Path.c_str());
+        if (!GenerateFile(Path, SizeGB) || !Reader.Open(Path))
+        {
+            fprintf(stderr, "could not create %s\n", Path.c_str());
+            return(1);
+        }
+    }
+
+    ScidSpan Records = Reader.Records();
+    const BarSettings BENCH_BARS[] = { { BAR_TIME, 60 }, { BAR_TRADES, 1000 }, { BAR_VOLUME, 5000 } };
+    const char* BENCH_NAMES[] = { "time 60s", "trades 1000", "volume 5000" };
+    int MaxThreads = max((int)std::thread::hardware_concurrency(), 1);
+
+    printf("%zu records, %d hardware threads\n", Records.size(), MaxThreads);
+    printf("%-12s %8s %10s %14s %18s\n", "bars", "threads", "seconds", "records/sec", "records/sec/core");
+    for (int b=0; b<3; b++)
+    {
+        vector<Bar> Bars;
+        for (int NumThreads = 1; ; NumThreads = min(NumThreads * 2, MaxThreads))
+        {
+            auto Start = std::chrono::steady_clock::now();
+            BuildBars(Records, BENCH_BARS[b], NumThreads, Bars);
+            double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+            double PerSecond = Records.size() / max(Seconds, 1e-9);
+            printf("%-12s %8d %10.3f %14.0f %18.0f\n", BENCH_NAMES[b], NumThreads, Seconds, PerSecond, PerSecond / NumThreads);
+            if (NumThreads == MaxThreads)
+            {
+                break;
+            }
+        }
+    }
+    return(0);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc >= 4 && strcmp(argv[1], "--bench") == 0)
+    {
+        return RunBenchmark(argv[2], atof(argv[3]));
+    }
+    if (argc < 4)
+    {
+        fprintf(stderr, "usage: scid_bars <file.scid> <time|trades|volume> <size> [--date YYYY-MM-DD] [--threads N]\n");
+        fprintf(stderr, "                 [--utc-offset HOURS] [--session-start HH:MM[:SS]]\n");
+        fprintf(stderr, "       scid_bars --bench <file.scid> <size in GB>\n");
+        return(1);
+    }
+
+    BarSettings Settings;
+    if (strcmp(argv[2], "time") == 0)
+    {
+        Settings.Type = BAR_TIME;
+    }
+    else if (strcmp(argv[2], "trades") == 0)
+    {
+        Settings.Type = BAR_TRADES;
+    }
+    else if (strcmp(argv[2], "volume") == 0)
+    {
+        Settings.Type = BAR_VOLUME;
+    }
+    else
+    {
+        fprintf(stderr, "unknown bar type '%s'\n", argv[2]);
+        return(1);
+    }
+    Settings.Size = atoll(argv[3]);
+    if (Settings.Size <= 0)
+    {
+        fprintf(stderr, "bar size must be positive\n");
+        return(1);
+    }
+
+    int NumThreads = max((int)std::thread::hardware_concurrency(), 1);
+    bool HaveDate = false;
+    int64_t DayStart = 0;
+    for (int i=4; i+1<argc; i+=2)
+    {
+        if (strcmp(argv[i], "--date") == 0)
+        {
+            HaveDate = ParseDate(argv[i+1], DayStart);
+            if (!HaveDate)
+            {
+                fprintf(stderr, "bad date '%s'\n", argv[i+1]);
+                return(1);
+            }
+        }
+        else if (strcmp(argv[i], "--threads") == 0)
+        {
+            NumThreads = max(atoi(argv[i+1]), 1);
+        }
+        else if (strcmp(argv[i], "--utc-offset") == 0)
+        {
+            Settings.UtcOffset = (int64_t)llround(atof(argv[i+1]) * 3600000000.0);
+        }
+        else if (strcmp(argv[i], "--session-start") == 0)
+        {
+            if (!ParseTimeOfDay(argv[i+1], Settings.SessionStart))
+            {
+                fprintf(stderr, "bad session start '%s'\n", argv[i+1]);
+                return(1);
+            }
+        }
+    }
+
+    ScidReader Reader;
+    if (!Reader.Open(argv[1]))
+    {
+        fprintf(stderr, "could not open %s\n", argv[1]);
+        return(1);
+    }
+
+    ScidSpan Records = Reader.Records();
+    if (HaveDate)
+    {
+        // the day in chart time
+        Records = Reader.Range(DayStart - Settings.UtcOffset, DayStart - Settings.UtcOffset + SCID_MICROSECONDS_PER_DAY);
+    }
+
+    vector<Bar> Bars;
+    BuildBars(Records, Settings, NumThreads, Bars);
+
+    printf("DateTime,Open,High,Low,Close,NumTrades,Volume,BidVolume,AskVolume\n");
+    for (const Bar &CurrBar : Bars)
+    {
+        // time bars are stamped with the bar start, others with their first trade, both in chart time
+        int64_t BarDateTime = Settings.Type == BAR_TIME ? CurrBar.Key : CurrBar.FirstDateTime + Settings.UtcOffset;
+        printf("%s,%g,%g,%g,%g,%llu,%llu,%llu,%llu\n", FormatDateTime(BarDateTime).c_str(),
+            CurrBar.Open, CurrBar.High, CurrBar.Low, CurrBar.Close,
+            (unsigned long long)CurrBar.NumTrades, (unsigned long long)CurrBar.Volume,
+            (unsigned long long)CurrBar.BidVolume, (unsigned long long)CurrBar.AskVolume);
+    }
+    return(0);
+}
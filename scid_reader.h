@@ -0,0 +1,343 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <string>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/*
+    Written by Frozen Tundra
+
+    Read-only memory mapped access to Sierra Chart .scid intraday files.
+    Doesn't need sierrachart.h so it builds outside of a study too.
+
+    File layout: 56 byte header then fixed size 40 byte records, oldest first.
+    Record DateTime is microseconds since 1899-12-30 UTC, same as SCDateTimeMS.
+*/
+
+struct ScidHeader
+{
+    char FileTypeUniqueHeaderID[4]; // "SCID"
+    uint32_t HeaderSize;
+    uint32_t RecordSize;
+    uint16_t Version;
+    uint16_t Unused1;
+    uint32_t UTCStartIndex;
+    char Reserve[36];
+};
+
+// same layout as s_IntradayRecord, studies can cast one to the other
+struct ScidRecord
+{
+    int64_t DateTime;
+    float Open;
+    float High; // ask price for single trades
+    float Low;  // bid price for single trades
+    float Close;
+    uint32_t NumTrades;
+    uint32_t TotalVolume;
+    uint32_t BidVolume;
+    uint32_t AskVolume;
+};
+
+static_assert(sizeof(ScidHeader) == 56, "unexpected .scid header size");
+static_assert(sizeof(ScidRecord) == 40, "unexpected .scid record size");
+
+// Open holds one of these for tick by tick records
+const float SCID_SINGLE_TRADE_WITH_BID_ASK = 0.0f;
+const float SCID_FIRST_SUB_TRADE_OF_UNBUNDLED_TRADE = -1.99900095e+37f;
+const float SCID_LAST_SUB_TRADE_OF_UNBUNDLED_TRADE = -1.99900197e+37f;
+
+const int64_t SCID_MICROSECONDS_PER_DAY = 86400000000LL;
+
+inline bool ScidIsSingleTrade(const ScidRecord& Record)
+{
+    return (Record.Open == SCID_SINGLE_TRADE_WITH_BID_ASK
+        || Record.Open == SCID_FIRST_SUB_TRADE_OF_UNBUNDLED_TRADE
+        || Record.Open == SCID_LAST_SUB_TRADE_OF_UNBUNDLED_TRADE);
+}
+
+// SCDateTime::GetAsDouble() days => record DateTime
+inline int64_t ScidDateTimeFromDays(double Days)
+{
+    return((int64_t)llround(Days * SCID_MICROSECONDS_PER_DAY));
+}
+
+inline double ScidDateTimeToDays(int64_t DateTime)
+{
+    return((double)DateTime / SCID_MICROSECONDS_PER_DAY);
+}
+
+// zero copy view of records inside the mapping, only valid until the next Refresh() or Close()
+struct ScidSpan
+{
+    const ScidRecord* Data = NULL;
+    size_t Count = 0;
+
+    const ScidRecord* begin() const { return Data; }
+    const ScidRecord* end() const { return Data + Count; }
+    size_t size() const { return Count; }
+    bool empty() const { return Count == 0; }
+    const ScidRecord& operator[](size_t i) const { return Data[i]; }
+};
+
+class ScidReader
+{
+    public:
+        ScidReader() {}
+        ~ScidReader() { Close(); }
+
+        ScidReader(const ScidReader&) = delete;
+        ScidReader& operator=(const ScidReader&) = delete;
+
+        // false if the file is missing or isn't a .scid file
+        bool Open(const std::string& FilePath)
+        {
+            Close();
+            Path = FilePath;
+#ifdef _WIN32
+            // sierra chart keeps writing to the file while we have it open
+            File = CreateFileA(Path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (File == INVALID_HANDLE_VALUE)
+            {
+                return(false);
+            }
+#else
+            File = open(Path.c_str(), O_RDONLY);
+            if (File < 0)
+            {
+                return(false);
+            }
+#endif
+            if (!Map() || !IsValidHeader())
+            {
+                Close();
+                return(false);
+            }
+            return(true);
+        }
+
+        void Close()
+        {
+            Unmap();
+#ifdef _WIN32
+            if (File != INVALID_HANDLE_VALUE)
+            {
+                CloseHandle(File);
+                File = INVALID_HANDLE_VALUE;
+            }
+#else
+            if (File >= 0)
+            {
+                close(File);
+                File = -1;
+            }
+#endif
+        }
+
+        bool IsOpen() const { return Base != NULL; }
+
+        // all zero when the file isn't open
+        const ScidHeader& GetHeader() const
+        {
+            static const ScidHeader Empty = {};
+            return Base != NULL ? *(const ScidHeader*)Base : Empty;
+        }
+
+        // whole records currently mapped, a partly written last record isn't counted
+        size_t Size() const { return NumRecords; }
+
+        ScidSpan Records() const
+        {
+            return Records(0, NumRecords);
+        }
+
+        ScidSpan Records(size_t First, size_t Count) const
+        {
+            ScidSpan Span;
+            if (Base == NULL || First >= NumRecords)
+            {
+                return(Span);
+            }
+            Span.Data = GetRecordPtr() + First;
+            Span.Count = Count < NumRecords - First ? Count : NumRecords - First;
+            return(Span);
+        }
+
+        // index of the first record with DateTime >= the one given, Size() if none, 0 when not open
+        size_t LowerBound(int64_t DateTime) const
+        {
+            if (Base == NULL)
+            {
+                return(0);
+            }
+            const ScidRecord* Records = GetRecordPtr();
+            size_t Lo = 0;
+            size_t Hi = NumRecords;
+            while (Lo < Hi)
+            {
+                size_t Mid = Lo + (Hi - Lo) / 2;
+                if (Records[Mid].DateTime < DateTime)
+                {
+                    Lo = Mid + 1;
+                }
+                else
+                {
+                    Hi = Mid;
+                }
+            }
+            return(Lo);
+        }
+
+        // records with From <= DateTime < To, empty when not open
+        ScidSpan Range(int64_t From, int64_t To) const
+        {
+            size_t First = LowerBound(From);
+            size_t Last = LowerBound(To);
+            return Records(First, Last > First ? Last - First : 0);
+        }
+
+        // tail follow, remap if the file grew and return how many whole records were added.
+        // spans taken before this call are invalid afterwards.
+        size_t Refresh()
+        {
+            if (File == INVALID_FILE)
+            {
+                return(0);
+            }
+            if (GetFileSize() <= MappedBytes)
+            {
+                return(0);
+            }
+            size_t OldNumRecords = NumRecords;
+            Unmap();
+            if (!Map())
+            {
+                return(0);
+            }
+            return(NumRecords > OldNumRecords ? NumRecords - OldNumRecords : 0);
+        }
+
+        // records appended since a Size() taken earlier
+        ScidSpan Since(size_t PrevSize) const
+        {
+            return Records(PrevSize, NumRecords > PrevSize ? NumRecords - PrevSize : 0);
+        }
+
+    private:
+#ifdef _WIN32
+        typedef HANDLE FileHandle;
+        const FileHandle INVALID_FILE = INVALID_HANDLE_VALUE;
+        HANDLE Mapping = NULL;
+#else
+        typedef int FileHandle;
+        const FileHandle INVALID_FILE = -1;
+#endif
+        std::string Path;
+        FileHandle File = INVALID_FILE;
+        const char* Base = NULL;
+        size_t MappedBytes = 0;
+        size_t NumRecords = 0;
+
+        const ScidRecord* GetRecordPtr() const
+        {
+            return (const ScidRecord*)(Base + GetHeader().HeaderSize);
+        }
+
+        bool IsValidHeader() const
+        {
+            const ScidHeader& Header = GetHeader();
+            return (Header.FileTypeUniqueHeaderID[0] == 'S'
+                && Header.FileTypeUniqueHeaderID[1] == 'C'
+                && Header.FileTypeUniqueHeaderID[2] == 'I'
+                && Header.FileTypeUniqueHeaderID[3] == 'D'
+                && Header.HeaderSize >= sizeof(ScidHeader)
+                && Header.HeaderSize <= MappedBytes
+                && Header.HeaderSize % 8 == 0
+                && Header.RecordSize == sizeof(ScidRecord));
+        }
+
+        size_t GetFileSize() const
+        {
+#ifdef _WIN32
+            LARGE_INTEGER FileSize;
+            if (!GetFileSizeEx(File, &FileSize))
+            {
+                return(0);
+            }
+            return((size_t)FileSize.QuadPart);
+#else
+            struct stat FileStat;
+            if (fstat(File, &FileStat) != 0)
+            {
+                return(0);
+            }
+            return((size_t)FileStat.st_size);
+#endif
+        }
+
+        bool Map()
+        {
+            size_t FileSize = GetFileSize();
+            if (FileSize < sizeof(ScidHeader))
+            {
+                return(false);
+            }
+#ifdef _WIN32
+            Mapping = CreateFileMappingA(File, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (Mapping == NULL)
+            {
+                return(false);
+            }
+            Base = (const char*)MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, FileSize);
+            if (Base == NULL)
+            {
+                CloseHandle(Mapping);
+                Mapping = NULL;
+                return(false);
+            }
+#else
+            void* Ptr = mmap(NULL, FileSize, PROT_READ, MAP_SHARED, File, 0);
+            if (Ptr == MAP_FAILED)
+            {
+                return(false);
+            }
+            Base = (const char*)Ptr;
+#endif
+            MappedBytes = FileSize;
+            uint32_t HeaderSize = GetHeader().HeaderSize;
+            NumRecords = HeaderSize <= MappedBytes ? (MappedBytes - HeaderSize) / sizeof(ScidRecord) : 0;
+            return(true);
+        }
+
+        void Unmap()
+        {
+#ifdef _WIN32
+            if (Base != NULL)
+            {
+                UnmapViewOfFile(Base);
+            }
+            if (Mapping != NULL)
+            {
+                CloseHandle(Mapping);
+                Mapping = NULL;
+            }
+#else
+            if (Base != NULL)
+            {
+                munmap((void*)Base, MappedBytes);
+            }
+#endif
+            Base = NULL;
+            MappedBytes = 0;
+            NumRecords = 0;
+        }
+};
@@ -0,0 +1,263 @@
+#define NOMINMAX
+#include "scid_reader.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*
+    Written by Frozen Tundra
+
+    Checks scid_reader.h against .scid fixture files it writes itself: lookups at
+    the edges, a reader that isn't open, an empty file, a partly written last record
+    and following the file as it grows.
+
+    Build:
+        g++ -O2 -std=c++17 scid_reader_test.cpp -o scid_reader_test
+        cl /O2 /EHsc /std:c++17 scid_reader_test.cpp
+
+    Usage:
+        scid_reader_test [fixture folder]
+    exits non zero if anything failed.
+*/
+
+static int NumFailed = 0;
+
+#define CHECK(x) do { if (!(x)) { fprintf(stderr, "FAILED line %d: %s\n", __LINE__, #x); NumFailed++; } } while (0)
+
+// a single trade record, the tests only look at DateTime
+ScidRecord MakeRecord(int64_t DateTime)
+{
+    ScidRecord Record;
+    memset(&Record, 0, sizeof(Record));
+    Record.DateTime = DateTime;
+    Record.Open = SCID_SINGLE_TRADE_WITH_BID_ASK;
+    Record.High = 100.25f;
+    Record.Low = 100.0f;
+    Record.Close = 100.0f;
+    Record.NumTrades = 1;
+    Record.TotalVolume = 1;
+    Record.BidVolume = 1;
+    return(Record);
+}
+
+void WriteHeader(FILE* File)
+{
+    ScidHeader Header;
+    memset(&Header, 0, sizeof(Header));
+    memcpy(Header.FileTypeUniqueHeaderID, "SCID", 4);
+    Header.HeaderSize = sizeof(ScidHeader);
+    Header.RecordSize = sizeof(ScidRecord);
+    Header.Version = 1;
+    fwrite(&Header, sizeof(Header), 1, File);
+}
+
+// header plus records with DateTimes First, First+Step, ...
+void WriteFixture(const std::string& Path, int NumRecords, int64_t First, int64_t Step, size_t ExtraBytes = 0)
+{
+    FILE* File = fopen(Path.c_str(), "wb");
+    WriteHeader(File);
+    for (int i=0; i<NumRecords; i++)
+    {
+        ScidRecord Record = MakeRecord(First + i * Step);
+        fwrite(&Record, sizeof(Record), 1, File);
+    }
+
+    // partly written record at the end, like sierra chart in the middle of a write
+    std::vector<char> Partial(ExtraBytes, 0x7f);
+    if (ExtraBytes > 0)
+    {
+        fwrite(Partial.data(), 1, ExtraBytes, File);
+    }
+    fclose(File);
+}
+
+void AppendRecords(const std::string& Path, int NumRecords, int64_t First, int64_t Step)
+{
+    FILE* File = fopen(Path.c_str(), "ab");
+    for (int i=0; i<NumRecords; i++)
+    {
+        ScidRecord Record = MakeRecord(First + i * Step);
+        fwrite(&Record, sizeof(Record), 1, File);
+    }
+    fclose(File);
+}
+
+void TestNotOpen(const std::string& Folder)
+{
+    ScidReader Reader;
+    CHECK(!Reader.IsOpen());
+    CHECK(Reader.Size() == 0);
+    CHECK(Reader.Records().empty());
+    CHECK(Reader.LowerBound(0) == 0);
+    CHECK(Reader.Range(0, 100).empty());
+    CHECK(Reader.Since(0).empty());
+    CHECK(Reader.Refresh() == 0);
+
+    // failed open leaves it closed, not half open
+    CHECK(!Reader.Open(Folder + "/does_not_exist.scid"));
+    CHECK(!Reader.IsOpen());
+    CHECK(Reader.Range(0, 100).empty());
+    CHECK(Reader.LowerBound(50) == 0);
+    CHECK(Reader.GetHeader().HeaderSize == 0);
+}
+
+void TestEmptyFiles(const std::string& Folder)
+{
+    // zero bytes isn't a .scid file
+    std::string Path = Folder + "/empty.scid";
+    FILE* File = fopen(Path.c_str(), "wb");
+    fclose(File);
+    ScidReader Reader;
+    CHECK(!Reader.Open(Path));
+    CHECK(Reader.Range(0, 100).empty());
+
+    // header but no records
+    Path = Folder + "/header_only.scid";
+    WriteFixture(Path, 0, 0, 0);
+    CHECK(Reader.Open(Path));
+    CHECK(Reader.Size() == 0);
+    CHECK(Reader.Records().empty());
+    CHECK(Reader.LowerBound(12345) == 0);
+    CHECK(Reader.Range(0, 100).empty());
+    CHECK(Reader.Since(0).empty());
+
+    // not a .scid file
+    Path = Folder + "/bad_header.scid";
+    File = fopen(Path.c_str(), "wb");
+    char Junk[256];
+    memset(Junk, 'x', sizeof(Junk));
+    fwrite(Junk, 1, sizeof(Junk), File);
+    fclose(File);
+    CHECK(!Reader.Open(Path));
+    CHECK(!Reader.IsOpen());
+}
+
+void TestLookups(const std::string& Folder)
+{
+    // DateTimes 1000, 1010, ... 1990
+    std::string Path = Folder + "/lookups.scid";
+    WriteFixture(Path, 100, 1000, 10);
+    ScidReader Reader;
+    CHECK(Reader.Open(Path));
+    CHECK(Reader.Size() == 100);
+    CHECK(Reader.Records()[0].DateTime == 1000);
+    CHECK(Reader.Records()[99].DateTime == 1990);
+
+    // before the first, on the first, between, on the last, after the last
+    CHECK(Reader.LowerBound(0) == 0);
+    CHECK(Reader.LowerBound(1000) == 0);
+    CHECK(Reader.LowerBound(1001) == 1);
+    CHECK(Reader.LowerBound(1010) == 1);
+    CHECK(Reader.LowerBound(1990) == 99);
+    CHECK(Reader.LowerBound(1991) == 100);
+    CHECK(Reader.LowerBound(INT64_MAX) == 100);
+
+    // To isn't included
+    ScidSpan Span = Reader.Range(1000, 1030);
+    CHECK(Span.size() == 3);
+    CHECK(Span[0].DateTime == 1000 && Span[2].DateTime == 1020);
+    CHECK(Reader.Range(1000, 1000).empty());
+    CHECK(Reader.Range(1030, 1000).empty());
+    CHECK(Reader.Range(0, 1000).empty());
+    CHECK(Reader.Range(2000, 3000).empty());
+    CHECK(Reader.Range(INT64_MIN, INT64_MAX).size() == 100);
+    CHECK(Reader.Range(1985, 5000).size() == 1);
+
+    // Records() clamps
+    CHECK(Reader.Records(99, 10).size() == 1);
+    CHECK(Reader.Records(100, 10).empty());
+
+    // equal DateTimes, lower bound is the first of them
+    Path = Folder + "/equal_times.scid";
+    FILE* File = fopen(Path.c_str(), "wb");
+    WriteHeader(File);
+    int64_t Times[] = {5, 7, 7, 7, 9};
+    for (int i=0; i<5; i++)
+    {
+        ScidRecord Record = MakeRecord(Times[i]);
+        fwrite(&Record, sizeof(Record), 1, File);
+    }
+    fclose(File);
+    CHECK(Reader.Open(Path));
+    CHECK(Reader.LowerBound(7) == 1);
+    CHECK(Reader.LowerBound(8) == 4);
+    CHECK(Reader.Range(7, 8).size() == 3);
+}
+
+void TestTruncated(const std::string& Folder)
+{
+    // 10 records and 17 bytes of the 11th
+    std::string Path = Folder + "/truncated.scid";
+    WriteFixture(Path, 10, 0, 1, 17);
+    ScidReader Reader;
+    CHECK(Reader.Open(Path));
+    CHECK(Reader.Size() == 10);
+    CHECK(Reader.Records().size() == 10);
+    CHECK(Reader.Records()[9].DateTime == 9);
+    CHECK(Reader.LowerBound(100) == 10);
+    CHECK(Reader.Range(0, 100).size() == 10);
+}
+
+void TestTailFollow(const std::string& Folder)
+{
+    std::string Path = Folder + "/tail.scid";
+    WriteFixture(Path, 5, 0, 1);
+    ScidReader Reader;
+    CHECK(Reader.Open(Path));
+    CHECK(Reader.Size() == 5);
+
+    // nothing new
+    CHECK(Reader.Refresh() == 0);
+    CHECK(Reader.Size() == 5);
+
+    // whole records appended
+    size_t PrevSize = Reader.Size();
+    AppendRecords(Path, 3, 5, 1);
+    CHECK(Reader.Refresh() == 3);
+    CHECK(Reader.Size() == 8);
+    ScidSpan New = Reader.Since(PrevSize);
+    CHECK(New.size() == 3);
+    CHECK(New[0].DateTime == 5 && New[2].DateTime == 7);
+    CHECK(Reader.Range(6, 100).size() == 2);
+
+    // half a record isn't counted until the rest of it shows up
+    PrevSize = Reader.Size();
+    ScidRecord Record = MakeRecord(8);
+    FILE* File = fopen(Path.c_str(), "ab");
+    fwrite(&Record, 1, 20, File);
+    fclose(File);
+    CHECK(Reader.Refresh() == 0);
+    CHECK(Reader.Size() == 8);
+    File = fopen(Path.c_str(), "ab");
+    fwrite((const char*)&Record + 20, 1, sizeof(Record) - 20, File);
+    fclose(File);
+    CHECK(Reader.Refresh() == 1);
+    CHECK(Reader.Since(PrevSize).size() == 1);
+    CHECK(Reader.Since(PrevSize)[0].DateTime == 8);
+    CHECK(Reader.Since(Reader.Size()).empty());
+}
+
+int main(int argc, char** argv)
+{
+    std::string Folder = argc >= 2 ? argv[1] : ".";
+    TestNotOpen(Folder);
+    TestEmptyFiles(Folder);
+    TestLookups(Folder);
+    TestTruncated(Folder);
+    TestTailFollow(Folder);
+
+    const char* Fixtures[] = {"empty", "header_only", "bad_header", "lookups", "equal_times", "truncated", "tail"};
+    for (const char* Name : Fixtures)
+    {
+        remove((Folder + "/" + Name + ".scid").c_str());
+    }
+
+    if (NumFailed > 0)
+    {
+        fprintf(stderr, "%d checks failed\n", NumFailed);
+        return(1);
+    }
+    printf("all checks passed\n");
+    return(0);
+}